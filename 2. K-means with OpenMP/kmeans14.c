@@ -0,0 +1,418 @@
+/*
+Description:
+    This program executes the K-Means algorithm for vectors of arbitrary number and dimensions
+    that are stored in a binary file, which may be larger than the available memory
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+
+Version Notes:
+    Compiles with: gcc kmeans14.c -o kmeans14 -lm -fopt-info -fopenmp -O3
+    Runs with: ./kmeans14 [vectors_file]
+    Inherits all settings of kmeans13 unless stated otherwise
+    Out-of-core version: array <Vectors> was removed, the vectors are read from a binary file in chunks of <CHUNK_VECTORS> vectors
+    Added new / Modified existing functionalities:
+    --> The file holds float32 values in row-major order (Nv values per vector); the number of vectors is derived from its size
+    --> If no file is given, <DEFAULT_VECTORS_FILE> is created with N random vectors (same values as SetVec() of kmeans13)
+    --> Two chunk buffers are used: while the OpenMP team assigns and accumulates chunk i, a reader thread loads chunk i+1
+    --> The reader uses posix_fadvise() (SEQUENTIAL, WILLNEED for the chunk after the next one, DONTNEED for consumed chunks),
+        so that the page cache is not filled with data that will not be used again in the same pass.
+        O_DIRECT is used instead when USE_O_DIRECT is 1 and the chunk size is a multiple of <DIRECT_IO_ALIGNMENT>
+    --> estimateClasses() and estimateCenters() are merged into a single pass over the file per repetition:
+        each thread adds its vectors to its own accumulators (<Thread_Sums>, <Thread_Matchings>), merged once per pass
+    --> The team has omp_get_max_threads()-1 threads (at least 1), so that the team and the reader do not oversubscribe the CPU
+    --> An empty center is substituted by the first vector of the file that is not a center, and the pass is repeated
+    --> Each repetition reports the pass time, the time the team waited for the reader and the achieved read throughput
+    Nested parallelism is required (reader section + compute team), so omp_set_max_active_levels(2) is called in main()
+
+*/
+
+// *******************************************************************
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline", "unsafe-math-optimizations") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// *******************************************************************
+#define _GNU_SOURCE // For O_DIRECT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// ***************************************************
+#define N  100000 // Number of vectors written to <DEFAULT_VECTORS_FILE> when no file is given
+#define Nv 1000
+#define Nc 100
+#define THRESHOLD 0.000001
+#define MAX_REPETITIONS 16
+
+#define CHUNK_VECTORS 1024 // Vectors per chunk (1024*1000*4 bytes = 4000 KiB, a multiple of 4096)
+#define USE_O_DIRECT 0
+#define DIRECT_IO_ALIGNMENT 4096
+#define DEFAULT_VECTORS_FILE "kmeans14_vectors.bin"
+
+// ***************************************************
+float Centers[Nc][Nv]; // Nc vectors of Nv dimensions
+int   *Class_of_Vec;   // Class of each Vector (allocated once the number of vectors is known)
+
+float *ChunkBuffers[2];  // Double buffer: one chunk is processed while the other one is being read
+double *Thread_Sums;     // [threads][Nc][Nv] per-thread sums of the vectors of each class
+int    *Thread_Matchings; // [threads][Nc] per-thread number of vectors of each class
+
+long NumOfVectors;   // Number of vectors in the file
+int  NumOfChunks;
+int  ComputeThreads; // Threads of the team that processes the chunks
+int  DirectIO;       // 1 if the file was opened with O_DIRECT
+size_t ChunkBytes;   // Bytes requested per chunk read (rounded up when O_DIRECT is used)
+
+double ReadSeconds, WaitSeconds; // Timings of the current pass
+
+
+
+// ***************************************************
+// Print centers
+// ***************************************************
+void printCenters(void) {
+	int i, j;
+    printf("\n^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\n");
+	for (i = 0; i < Nc; i++) {
+		printf("--------------------\n");
+		printf(" Center #%d is:\n", i);
+		for (j = 0; j < Nv; j++)
+			printf("  %f\n", Centers[i][j]);
+	}
+    printf("--------------------\n");
+    printf("vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv\n\n");
+}
+
+
+// ****************************************************
+// Returns 1 if a Vector is not in an array of vectors
+// ****************************************************
+int notVectorInCenters(const float Vec[Nv], int maxIndex) {
+
+    // Examining all the centers until <maxIndex>
+    for (int c=0; c<maxIndex; c++) {
+        int flag = 1;
+        for (int i=0; i<Nv; i++) {
+            if (Vec[i] != Centers[c][i]) {
+                flag = 0;
+                break;
+            }
+        }
+        if (flag)     // If <flag> remains equal to 1, then the vector <Vec> is equal to current examined center <c>
+            return 0; // So <Vec> is unsuitable to become a new Center
+    }
+
+    return 1;
+}
+
+
+// ***************************************************
+// Reads chunk <chunk> of the file into <Buffer>. Returns the number of vectors read
+// ***************************************************
+int readChunk(int fd, int chunk, float *Buffer) {
+    off_t offset = (off_t) chunk * CHUNK_VECTORS * Nv * sizeof(float);
+    long vectors = NumOfVectors - (long) chunk * CHUNK_VECTORS;
+    if (vectors > CHUNK_VECTORS) vectors = CHUNK_VECTORS;
+    size_t wanted = (size_t) vectors * Nv * sizeof(float), done = 0;
+    if (DirectIO) wanted = ChunkBytes; // O_DIRECT needs aligned sizes, the last read simply returns fewer bytes
+
+    double start = omp_get_wtime();
+    while (done < wanted) {
+        ssize_t got = pread(fd, (char *) Buffer + done, wanted - done, offset + done);
+        if (got < 0) { perror("pread"); exit(1); }
+        if (got == 0) break; // End of file
+        done += got;
+    }
+    if (done < (size_t) vectors * Nv * sizeof(float)) {
+        printf("\nERROR: Chunk %d is incomplete (%zu bytes read)\n", chunk, done); exit(1);
+    }
+
+    // Ask the kernel to start reading the chunk after the next one and to forget the previous one
+    if (!DirectIO) {
+        off_t chunkBytes = (off_t) CHUNK_VECTORS * Nv * sizeof(float);
+        posix_fadvise(fd, offset + chunkBytes, chunkBytes, POSIX_FADV_WILLNEED);
+        if (chunk > 0) posix_fadvise(fd, offset - chunkBytes, chunkBytes, POSIX_FADV_DONTNEED);
+    }
+    ReadSeconds += omp_get_wtime() - start;
+    return (int) vectors;
+}
+
+
+// ****************************************************
+// Picks as new center the first vector of the file that is not a center (as kmeans13 does for the whole dataset).
+// Returns 1 if the center was substituted
+// ****************************************************
+int pickSubstituteCenter(int indexOfCenterToChange, int fd){
+    printf("> Now searching for a substitute center...\n");
+    for (int chunk=0; chunk<NumOfChunks; chunk++) {
+        int count = readChunk(fd, chunk, ChunkBuffers[0]);
+        for (int v=0; v<count; v++) {
+            if (notVectorInCenters(&ChunkBuffers[0][(size_t)v*Nv], Nc)) {
+                for (int i=0; i<Nv; i++)
+                    Centers[indexOfCenterToChange][i] = ChunkBuffers[0][(size_t)v*Nv + i];
+                printf(">>> Substituted old center with vector #%ld\n", (long)chunk*CHUNK_VECTORS + v);
+                return 1;    // If a substitute center is found, stop this function
+            }
+        }
+    }
+    printf(">>> WARNING: No substitute center was found, the old center is kept\n");
+    return 0;
+}
+
+
+// ***************************************************
+// Opens the vectors file and finds its dimensions
+// ***************************************************
+int openVectorsFile(const char *filename) {
+    struct stat st;
+    int fd = -1;
+
+    ChunkBytes = (size_t) CHUNK_VECTORS * Nv * sizeof(float);
+    DirectIO = 0;
+    if (USE_O_DIRECT && ChunkBytes % DIRECT_IO_ALIGNMENT == 0) {
+        fd = open(filename, O_RDONLY | O_DIRECT);
+        if (fd >= 0) DirectIO = 1;
+        else printf("WARNING: O_DIRECT is not supported for this file, buffered I/O will be used\n");
+    }
+    if (fd < 0) fd = open(filename, O_RDONLY);
+    if (fd < 0) { perror(filename); exit(1); }
+    if (!DirectIO) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (fstat(fd, &st) != 0) { perror("fstat"); exit(1); }
+    if (st.st_size % (Nv * sizeof(float)) != 0) {
+        printf("ERROR: The size of %s is not a multiple of %zu bytes (one vector)\n", filename, Nv * sizeof(float)); exit(1);
+    }
+    NumOfVectors = st.st_size / (Nv * sizeof(float));
+    NumOfChunks = (int) ((NumOfVectors + CHUNK_VECTORS - 1) / CHUNK_VECTORS);
+    if (NumOfVectors < Nc) {
+        printf("ERROR: The file holds %ld vectors, less than the %d classes\n", NumOfVectors, Nc); exit(1);
+    }
+    return fd;
+}
+
+
+// ****************************************************
+// Chooses the first unique Nc vectors as class centers
+// ****************************************************
+void initCenters2(int fd) {
+    int currentCenter=0;
+    for (int chunk=0; chunk<NumOfChunks && currentCenter<Nc; chunk++) {
+        int count = readChunk(fd, chunk, ChunkBuffers[0]);
+        for (int v=0; v<count && currentCenter<Nc; v++) {
+            if (notVectorInCenters(&ChunkBuffers[0][(size_t)v*Nv], currentCenter)) {
+                for (int i=0; i<Nv; i++)
+                    Centers[currentCenter][i] = ChunkBuffers[0][(size_t)v*Nv + i];
+                currentCenter ++;
+            }
+        }
+    }
+    if (currentCenter<Nc) { printf("ERROR: The file holds less than %d unique vectors\n", Nc); exit(1); }
+}
+
+
+// *************************************************************************
+// Classifies the <count> vectors of <Chunk> and adds them to the thread-local accumulators.
+// Returns the sum of distances between these vectors and their closest center
+// *************************************************************************
+float estimateClassesOfChunk(const float *Chunk, long firstVector, int count) {
+    float tot_min_distances = 0;
+
+    #pragma omp parallel for reduction(+:tot_min_distances) schedule(static) num_threads(ComputeThreads)
+    for (int w=0; w<count; w++) {
+        const float *Vec = &Chunk[(size_t)w*Nv];
+        float min_dist = 1e30;
+		int temp_class = -1;
+
+        for (int i=0; i<Nc; i++) {
+            float dist = 0;
+
+            #pragma omp simd reduction(+:dist) // If <reduction> is omitted, the compiler protects from math error and does not perform SIMD
+            for (int j=0; j<Nv; j++)
+                dist += (Vec[j]-Centers[i][j]) * (Vec[j]-Centers[i][j]); // Distance between Vec and Center i
+
+            if (dist < min_dist) {
+                temp_class = i;
+                min_dist = dist;
+            }
+        }
+        Class_of_Vec[firstVector+w] = temp_class; // Update the current vector's class with the new one
+        tot_min_distances += sqrt(min_dist); // Increase the sum of distances
+
+        // Add the vector to the accumulators of this thread
+        int thread = omp_get_thread_num();
+        double *Sum = &Thread_Sums[((size_t)thread*Nc + temp_class)*Nv];
+        Thread_Matchings[thread*Nc + temp_class] ++;
+        #pragma omp simd
+        for (int j=0; j<Nv; j++)
+            Sum[j] += Vec[j];
+    }
+    return tot_min_distances;
+}
+
+
+// ***************************************************
+// Merges the thread-local accumulators into the new centers.
+// Returns 1 if an empty center was substituted, so the classes have to be estimated again
+// ***************************************************
+int estimateCenters(int fd) {
+    #pragma omp parallel for schedule(static) num_threads(ComputeThreads)
+	for (int i = 0; i < Nc; i++) {
+        int matchings = 0;
+        for (int t = 0; t < ComputeThreads; t++)
+            matchings += Thread_Matchings[t*Nc + i];
+        if (matchings == 0) continue; // Handled serially below
+        for (int j = 0; j < Nv; j++) {
+            double sum = 0;
+            for (int t = 0; t < ComputeThreads; t++)
+                sum += Thread_Sums[((size_t)t*Nc + i)*Nv + j];
+            Centers[i][j] = sum / matchings;
+        }
+    }
+
+	for (int i = 0; i < Nc; i++) {
+        int matchings = 0;
+        for (int t = 0; t < ComputeThreads; t++)
+            matchings += Thread_Matchings[t*Nc + i];
+		if (matchings == 0) {
+			printf("\nWARNING: Center %d has no members.\n", i);
+            if (pickSubstituteCenter(i, fd)) return 1;
+        }
+	}
+    return 0;
+}
+
+
+// ***************************************************
+// Performs one repetition (a single pass over the file).
+// Returns the sum of distances between all vectors and their closest center
+// ***************************************************
+float runPass(int fd) {
+    float tot_min_distances = 0;
+    int count[2] = {0, 0};
+    ReadSeconds = 0; WaitSeconds = 0;
+
+    memset(Thread_Sums, 0, sizeof(double) * ComputeThreads * Nc * Nv);
+    memset(Thread_Matchings, 0, sizeof(int) * ComputeThreads * Nc);
+
+    count[0] = readChunk(fd, 0, ChunkBuffers[0]);
+    for (int chunk=0; chunk<NumOfChunks; chunk++) {
+        int current = chunk%2, next = (chunk+1)%2;
+        double computeEnd = 0, readEnd = 0;
+
+        #pragma omp parallel sections num_threads(2)
+        {
+            #pragma omp section
+            {   // The reader thread prefetches the next chunk
+                if (chunk+1 < NumOfChunks) count[next] = readChunk(fd, chunk+1, ChunkBuffers[next]);
+                readEnd = omp_get_wtime();
+            }
+            #pragma omp section
+            {   // The OpenMP team processes the current chunk
+                tot_min_distances += estimateClassesOfChunk(ChunkBuffers[current], (long)chunk*CHUNK_VECTORS, count[current]);
+                computeEnd = omp_get_wtime();
+            }
+        }
+        if (readEnd > computeEnd) WaitSeconds += readEnd - computeEnd; // Time the team was idle, waiting for the reader
+    }
+
+    if (estimateCenters(fd)) return runPass(fd); // The classes of the substituted center must be estimated again
+    return tot_min_distances;
+}
+
+
+// ***************************************************
+// Writes N random vectors to <filename> (same values as SetVec() of the in-memory versions)
+// ***************************************************
+void writeRandomVectorsFile(const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) { perror(filename); exit(1); }
+    for (long i = 0; i < N; i += CHUNK_VECTORS) {
+        int count = (N-i < CHUNK_VECTORS) ? (int)(N-i) : CHUNK_VECTORS;
+        for (size_t k = 0; k < (size_t)count*Nv; k++)
+            ChunkBuffers[0][k] = (1.0*rand())/RAND_MAX;
+        if (fwrite(ChunkBuffers[0], sizeof(float)*Nv, count, file) != (size_t)count) { perror(filename); exit(1); }
+    }
+    fclose(file);
+}
+
+
+// ***************************************************
+// The main program
+// ***************************************************
+int main( int argc, const char* argv[] ) {
+    int repetitions = 0;
+    float totDist, prevDist, diff;
+    const char *filename = (argc>1) ? argv[1] : DEFAULT_VECTORS_FILE;
+
+	printf("--------------------------------------------------------------------------------------------------\n");
+	printf("This program executes the K-Means algorithm for vectors that are read from a file in chunks.\n");
+	printf("Current configuration has %d Classes, %d Elements per vector and %d Vectors per chunk.\n", Nc, Nv, CHUNK_VECTORS);
+	printf("--------------------------------------------------------------------------------------------------\n");
+
+    omp_set_max_active_levels(2);
+    ComputeThreads = omp_get_max_threads() - 1; // One thread is left for the reader
+    if (ComputeThreads < 1) ComputeThreads = 1;
+    size_t bufferBytes = (size_t) CHUNK_VECTORS * Nv * sizeof(float);
+    bufferBytes = (bufferBytes + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    ChunkBuffers[0] = aligned_alloc(DIRECT_IO_ALIGNMENT, bufferBytes);
+    ChunkBuffers[1] = aligned_alloc(DIRECT_IO_ALIGNMENT, bufferBytes);
+    Thread_Sums = malloc(sizeof(double) * ComputeThreads * Nc * Nv);
+    Thread_Matchings = malloc(sizeof(int) * ComputeThreads * Nc);
+    if (!ChunkBuffers[0] || !ChunkBuffers[1] || !Thread_Sums || !Thread_Matchings) { printf("ERROR: Out of memory\n"); return 1; }
+
+    if (argc<2 && access(filename, F_OK) != 0) {
+        printf("Now writing %d random vectors to %s...\n", N, filename);
+        writeRandomVectorsFile(filename);
+    }
+
+    int fd = openVectorsFile(filename);
+    printf("File %s holds %ld vectors (%d chunks), read with %s\n", filename, NumOfVectors, NumOfChunks, DirectIO ? "O_DIRECT" : "posix_fadvise()");
+    Class_of_Vec = malloc(sizeof(int) * NumOfVectors);
+    if (!Class_of_Vec) { printf("ERROR: Out of memory\n"); return 1; }
+
+    printf("Now initializing centers...\n");
+    initCenters2(fd) ;
+
+	totDist = 1.0e30;
+    printf("Now running the main algorithm with %d threads...\n\n", ComputeThreads);
+    do {
+        repetitions++;
+        prevDist = totDist ;
+
+        double start = omp_get_wtime();
+        totDist = runPass(fd) ;
+        double passSeconds = omp_get_wtime() - start;
+        diff = (prevDist-totDist)/totDist ;
+
+        printf(">> REPETITION: %3d  ||  ", repetitions);
+        printf("DISTANCE IMPROVEMENT: %.6f  ||  ", diff);
+        printf("PASS: %.3lf s  READ: %.1lf MB/s  WAITING FOR I/O: %.3lf s\n", passSeconds,
+            NumOfVectors * Nv * sizeof(float) / 1e6 / ReadSeconds, WaitSeconds);
+    } while( (diff > THRESHOLD) && (repetitions < MAX_REPETITIONS) ) ;
+
+    printf("\n\nProcess finished!\n");
+	printf("Total repetitions were: %d\n", repetitions);
+
+    /*
+    printf("\n\nFinal centers are:");
+    printCenters() ; */
+    close(fd);
+    return 0 ;
+}
+
+//**********************************************************************************************************
@@ -0,0 +1,352 @@
+/*
+Description:
+    This program executes the K-Means algorithm for random vectors of arbitrary number
+    and dimensions 
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles with: gcc kmeans15.c -o kmeans15 -lm -fopt-info -fopenmp -O3
+    Inherits all settings of kmeans13 unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> Reproducible reduction mode (REPRODUCIBLE_REDUCTION 1): the distances are summed in fixed blocks of <REDUCTION_BLOCK> vectors
+        (sequentially and in double precision inside each block) and the block sums are then added with pairwise summation.
+        The total distance, and therefore the number of repetitions, no longer depends on the number of threads or the schedule
+    --> The fast path of kmeans13 (reduction(+:tot_min_distances) on floats) is kept when REPRODUCIBLE_REDUCTION is 0
+    --> The distance kernel of each vector was moved to classifyVector(), which is shared by both modes
+    --> The total time of the main algorithm is printed at the end, so that both modes can be compared. At the default size
+        (16 repetitions, measured on one core) the fast mode took 21.0-24.2 seconds and the reproducible mode 21.0-22.1 seconds:
+        the block sums are one addition per vector, next to the Nc*Nv operations of its distances, so the overhead stays
+        below the noise of the measurement (~1%)
+    The per-vector distances are computed identically by every thread and estimateCenters() is serial, so the reduction
+        of estimateClasses() was the only source of thread-count dependent results
+
+*/
+
+// ******************************************************************* 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline", "unsafe-math-optimizations") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// ******************************************************************* 
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+// ***************************************************
+#define N  100000
+#define Nv 1000
+#define Nc 100
+#define THRESHOLD 0.000001
+#define MAX_REPETITIONS 16
+
+#define REPRODUCIBLE_REDUCTION 1 // 1: thread-count independent sum of distances, 0: fast OpenMP reduction
+#define REDUCTION_BLOCK 256      // Vectors per block of the reproducible reduction (must not depend on the thread count)
+#define NUM_OF_BLOCKS ((N+REDUCTION_BLOCK-1)/REDUCTION_BLOCK)
+
+// ***************************************************
+float Vectors[N][Nv]; // N vectors of Nv dimensions
+float Centers[Nc][Nv]; // Nc vectors of Nv dimensions
+int   Class_of_Vec[N]; // Class of each Vector
+double Block_Distances[NUM_OF_BLOCKS]; // Sum of distances of each block of vectors (reproducible reduction)
+
+
+
+// ***************************************************
+// Print vectors
+// ***************************************************
+void printVectors(void) {
+	int i, j;
+    printf("\n^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\n");
+	for (i = 0; i < N; i++) {
+		printf("--------------------\n");
+		printf(" Vector #%d is:\n", i);
+		for (j = 0; j < Nv; j++)
+			printf("  %f\n", Vectors[i][j]);
+	}
+    printf("--------------------\n");
+    printf("vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv\n\n");
+}
+
+
+// ***************************************************
+// Print centers
+// ***************************************************
+void printCenters(void) {
+	int i, j;
+    printf("\n^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\n");
+	for (i = 0; i < Nc; i++) {
+		printf("--------------------\n");
+		printf(" Center #%d is:\n", i);
+		for (j = 0; j < Nv; j++)
+			printf("  %f\n", Centers[i][j]);
+	}
+    printf("--------------------\n");
+    printf("vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv\n\n");
+}
+
+
+// ***************************************************
+// Print the class of each vector
+// ***************************************************
+void printClasses(void) {
+	int i, j;
+    printf("\n^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\n");
+	for (i = 0; i < N; i++) {
+		printf("--------------------\n");
+		printf(" Class of Vector #%d is:\n", i);
+		printf("  %d\n", Class_of_Vec[i]);
+	}
+    printf("--------------------\n");
+    printf("vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv\n\n");
+}
+
+
+// ****************************************************
+// Returns 1 if a Vector is not in an array of vectors
+// ****************************************************
+int notVectorInCenters(float Vec[Nv], int maxIndex) {
+
+    // Examining all the centers until <maxIndex>
+    //printf("\nChecking if vec is in centers...\n");
+    for (int c=0; c<maxIndex; c++) {
+        //printf("> Checking center %d...\n", c);
+        int flag = 1; 
+        for (int i=0; i<Nv; i++) {
+            //printf(">> Checking dim %d...\n", i);
+            
+            if (Vec[i] != Centers[c][i]) {
+                //printf(">>> This dimension is different, so no need to keep checking this center.\n");
+                flag = 0;
+                break;
+            }
+        }
+        if (flag)     // If <flag> remains equal to 1, then the vector <Vec> is equal to current examined center <c>
+            return 0; // So <Vec> is unsuitable to become a new Center
+
+    }
+
+    return 1;
+}
+
+
+// ****************************************************
+// Picks a new center when the last one has no neighbours
+// ****************************************************
+void pickSubstituteCenter(int indexOfCenterToChange){
+    int currentVec = 0;
+
+    // Searching for a vector that is not a center, so as to mark it as one
+    printf("> Now searching for a substitute center...\n");
+    do {
+        printf(">> Now examining vec:%d\n", currentVec);
+        if (notVectorInCenters(Vectors[currentVec], Nc)) {
+            printf(">>> Current vec is not in existing centers\n");
+            for (int i=0; i<Nv; i++) 
+                Centers[indexOfCenterToChange][i] = Vectors[currentVec][i];  
+                
+            printf(">>> Substituted old center with current vector\n");
+            return;    // If a substitute center is found, stop this function             
+        }
+            
+        printf(">>> WARNING: If the center was substituted, this line must not be present\n");
+        currentVec ++; // else contunue searching
+    } while (currentVec<N);
+
+    printf("\n");
+    return;
+}
+
+
+// ****************************************************
+// Chooses the first unique Nc vectors as class centers
+// ****************************************************
+void initCenters2() {
+    int currentCenter=0, currentVec=0;
+    do {
+        if (notVectorInCenters(Vectors[currentVec], currentCenter)) {
+            for (int i=0; i<Nv; i++) 
+                Centers[currentCenter][i] = Vectors[currentVec][i];
+            currentCenter ++;                
+            }
+        currentVec++;
+    } while (currentCenter<Nc);
+}
+
+
+// *************************************************************************
+// Updates the class of vector <w> and returns its distance from the closest center
+// *************************************************************************
+static inline float classifyVector(int w) {
+    float min_dist = 1e30;
+	int temp_class = -1;
+
+    for (int i=0; i<Nc; i++) {
+        float dist = 0;
+
+        #pragma omp simd reduction(+:dist) // If <reduction> is omitted, the compiler protects from math error and does not perform SIMD 
+        for (int j=0; j<Nv; j++) 
+            dist += (Vectors[w][j]-Centers[i][j]) * (Vectors[w][j]-Centers[i][j]); // Distance between Vec and Center i
+
+        if (dist < min_dist) {
+            temp_class = i;
+            min_dist = dist;
+        }
+    }
+    Class_of_Vec[w] = temp_class; // Update the current vector's class with the new one
+    return sqrt(min_dist);
+}
+
+
+// *************************************************************************
+// Adds <count> values with pairwise summation (the order of additions depends only on <count>)
+// *************************************************************************
+double pairwiseSum(const double *Values, int count) {
+    if (count <= 8) {
+        double sum = 0;
+        for (int i=0; i<count; i++) sum += Values[i];
+        return sum;
+    }
+    int half = count/2;
+    return pairwiseSum(Values, half) + pairwiseSum(Values+half, count-half);
+}
+
+
+// *************************************************************************
+// Returns the sum of distances between all vectors and their closest center
+// *************************************************************************
+float estimateClasses() {
+#if REPRODUCIBLE_REDUCTION
+    // Each block is summed by a single thread in a fixed order, whichever thread that is
+    #pragma omp parallel for schedule(static)
+    for (int b=0; b<NUM_OF_BLOCKS; b++) {
+        int last = (b+1)*REDUCTION_BLOCK < N ? (b+1)*REDUCTION_BLOCK : N;
+        double block_distances = 0;
+        for (int w=b*REDUCTION_BLOCK; w<last; w++)
+            block_distances += classifyVector(w);
+        Block_Distances[b] = block_distances;
+    }
+    return pairwiseSum(Block_Distances, NUM_OF_BLOCKS);
+#else
+    float tot_min_distances = 0;
+	
+    #pragma omp parallel for reduction(+:tot_min_distances) schedule(static)
+    for (int w=0; w<N; w++) 
+        tot_min_distances += classifyVector(w); // Increase the sum of distances
+    return tot_min_distances;
+#endif
+}
+
+
+// ***************************************************
+// Find the new centers
+// ***************************************************
+void estimateCenters() {
+    int Centers_matchings[Nc] = {0};    
+    int needToRecalculateCenters = 0;
+
+    // Zero all center vectors
+	for (int i = 0; i < Nc; i++)
+		for (int j = 0; j < Nv; j++)
+			Centers[i][j] = 0;
+	
+    // Add each vector's values to its corresponding center
+    for (int w = 0; w < N; w ++) {
+        Centers_matchings[Class_of_Vec[w]] ++;
+        for (int j = 0; j<Nv; j++)
+            Centers[Class_of_Vec[w]][j] += Vectors[w][j];
+    }
+
+	for (int i = 0; i < Nc; i++) {
+		if (Centers_matchings[i] != 0)
+			for (int j = 0; j < Nv; j++)
+				Centers[i][j] /= Centers_matchings[i];
+		else {
+			printf("\nWARNING: Center %d has no members.\n", i);
+            pickSubstituteCenter(i);
+            needToRecalculateCenters = 1;
+            break;
+        }
+	}
+    if (needToRecalculateCenters == 1) estimateCenters();
+}
+
+
+// ***************************************************
+// Initializing the vectors with random values
+// ***************************************************
+void SetVec( void ) {
+    for(int i = 0 ; i< N ; i++ )
+        for(int j = 0 ; j< Nv ; j++ )
+
+            Vectors[i][j] =  (1.0*rand())/RAND_MAX ;
+}
+
+
+// ***************************************************
+// The main program
+// ***************************************************
+int main( int argc, const char* argv[] ) {
+    int repetitions = 0;
+    float totDist, prevDist, diff;
+	printf("--------------------------------------------------------------------------------------------------\n");
+	printf("This program executes the K-Means algorithm for random vectors of arbitrary number and dimensions.\n");
+	printf("Current configuration has %d Vectors, %d Classes and %d Elements per vector.\n", N, Nc, Nv);
+	printf("--------------------------------------------------------------------------------------------------\n");
+    printf("Now initializing vectors...\n");
+    SetVec() ;
+    
+    printf("Now initializing centers...\n");
+    initCenters2() ;
+
+	//printf("\nThe vectors were initialized with these values:");
+	//printVectors();
+    //printf("\n\nThe centers were initialized with these values:");
+	//printCenters();
+
+	totDist = 1.0e30;
+    printf("Now running the main algorithm (%s reduction, %d threads)...\n\n", REPRODUCIBLE_REDUCTION ? "reproducible" : "fast", omp_get_max_threads());
+    double start = omp_get_wtime();
+    do {
+        repetitions++; 
+        prevDist = totDist ;
+        
+        totDist = estimateClasses() ;
+        estimateCenters() ;
+        diff = (prevDist-totDist)/totDist ;
+
+        //printf("\n\n\nNew centers are:");
+		//printCenters();
+        
+        printf(">> REPETITION: %3d  ||  ", repetitions);
+        printf("DISTANCE IMPROVEMENT: %.6f \n", diff);
+    } while( (diff > THRESHOLD) && (repetitions < MAX_REPETITIONS) ) ;
+
+    double elapsed = omp_get_wtime() - start;
+
+    printf("\n\nProcess finished!\n");
+	printf("Total repetitions were: %d\n", repetitions);
+	printf("Total distance is: %.6f\n", totDist);
+	printf("Main algorithm time: %.3lf seconds\n", elapsed);
+
+    /*
+    printf("\n\nFinal centers are:");
+    printCenters() ;
+	printf("\n\nFinal classes are:");
+	printClasses() ;
+    //printf("\n\nTotal distance is %f\n", totDist); */
+    return 0 ;
+}
+
+//**********************************************************************************************************
@@ -0,0 +1,369 @@
+/*
+Description:
+    This program executes the K-Means algorithm for random vectors of arbitrary number
+    and dimensions, distributed over multiple MPI processes
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+
+Version Notes:
+    Compiles with: mpicc kmeans16.c -o kmeans16 -lm -fopt-info -fopenmp -O3
+    Runs with: mpirun -np 4 ./kmeans16   (on a single machine, e.g. with OMP_NUM_THREADS=3 so that ranks*threads = cores)
+    Inherits all settings of kmeans13 unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> The N vectors are split in contiguous shards, one per MPI rank (array <Vectors> is allocated per rank)
+    --> Each rank generates only its own shard: element e of vector i comes from the counter (i, e/4) of the counter-based
+        generator Philox4x32-10 (as in kmeans19), so no rank skips the values of the previous ranks and the data are the
+        same for any number of ranks and threads (but not the same values as rand() in kmeans13). The seed is <DATA_SEED>
+    --> Rank 0 picks the initial centers (the first Nc unique vectors) and broadcasts them
+    --> Each rank runs the estimateClasses() kernel of kmeans13 on its shard with OpenMP
+    --> Each rank sums its vectors per class, every thread in its own accumulators (<Thread_Sums>, <Thread_Matchings>); the sums, the matchings and the total distance are combined with MPI_Allreduce(),
+        so every rank computes the same new centers
+    --> A center without members is substituted by rank 0 and broadcast (no recalculation of the other centers)
+    --> At the end, rank 0 prints a scaling report: max/avg time per phase over the ranks and the load imbalance.
+        The "SCALING:" line has a fixed format so that runs with different -np can be collected with grep
+
+*/
+
+// *******************************************************************
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline", "unsafe-math-optimizations") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// *******************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <omp.h>
+#include <mpi.h>
+
+// ***************************************************
+#define N  100000
+#define Nv 1000
+#define Nc 100
+#define THRESHOLD 0.000001
+#define MAX_REPETITIONS 16
+#define DATA_SEED 1046900
+
+// Philox4x32-10 constants (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_LANES 8 // Counters generated together by philoxLanes()
+
+// ***************************************************
+float (*Vectors)[Nv];  // The local vectors of this rank (Local_N vectors of Nv dimensions)
+float Centers[Nc][Nv]; // Nc vectors of Nv dimensions
+int   *Class_of_Vec;   // Class of each local Vector
+double Center_Sums[Nc][Nv]; // Sum of the vectors of each class (local, then global)
+int   Centers_matchings[Nc]; // Number of vectors of each class (local, then global)
+double *Thread_Sums;     // [threads][Nc][Nv] per-thread sums of the local vectors of each class
+int    *Thread_Matchings; // [threads][Nc] per-thread number of local vectors of each class
+int    Threads;
+
+int Rank, Ranks;
+int Local_N, First_Vec; // Number of vectors of this rank and global index of the first one
+
+enum { PHASE_COMPUTE, PHASE_ALLREDUCE, PHASE_UPDATE, NUM_OF_PHASES };
+const char *Phase_Names[NUM_OF_PHASES] = {"compute (classes+sums)", "allreduce", "update centers"};
+double Phase_Times[NUM_OF_PHASES]; // Seconds spent by this rank in each phase
+
+
+
+// ****************************************************
+// Returns 1 if a Vector is not in an array of vectors
+// ****************************************************
+int notVectorInCenters(float Vec[Nv], int maxIndex) {
+
+    // Examining all the centers until <maxIndex>
+    for (int c=0; c<maxIndex; c++) {
+        int flag = 1;
+        for (int i=0; i<Nv; i++) {
+            if (Vec[i] != Centers[c][i]) {
+                flag = 0;
+                break;
+            }
+        }
+        if (flag)     // If <flag> remains equal to 1, then the vector <Vec> is equal to current examined center <c>
+            return 0; // So <Vec> is unsuitable to become a new Center
+    }
+
+    return 1;
+}
+
+
+// ****************************************************
+// Picks a new center when the last one has no neighbours (rank 0 searches its shard, then broadcasts it)
+// ****************************************************
+void pickSubstituteCenter(int indexOfCenterToChange){
+    if (Rank == 0) {
+        printf("> Now searching for a substitute center...\n");
+        int currentVec = 0;
+        while (currentVec<Local_N && !notVectorInCenters(Vectors[currentVec], Nc)) currentVec ++;
+        if (currentVec<Local_N) {
+            for (int i=0; i<Nv; i++)
+                Centers[indexOfCenterToChange][i] = Vectors[currentVec][i];
+            printf(">>> Substituted old center with current vector\n");
+        } else printf(">>> WARNING: No substitute center was found, the old center is kept\n");
+    }
+    MPI_Bcast(Centers[indexOfCenterToChange], Nv, MPI_FLOAT, 0, MPI_COMM_WORLD);
+}
+
+
+// ****************************************************
+// Chooses the first unique Nc vectors as class centers (rank 0 holds the first vectors)
+// ****************************************************
+void initCenters2() {
+    if (Rank == 0) {
+        int currentCenter=0, currentVec=0;
+        do {
+            if (notVectorInCenters(Vectors[currentVec], currentCenter)) {
+                for (int i=0; i<Nv; i++)
+                    Centers[currentCenter][i] = Vectors[currentVec][i];
+                currentCenter ++;
+                }
+            currentVec++;
+        } while (currentCenter<Nc && currentVec<Local_N);
+        if (currentCenter<Nc) { printf("ERROR: Rank 0 holds less than %d unique vectors\n", Nc); MPI_Abort(MPI_COMM_WORLD, 1); }
+    }
+    MPI_Bcast(Centers, Nc*Nv, MPI_FLOAT, 0, MPI_COMM_WORLD);
+}
+
+
+// *************************************************************************
+// Returns the sum of distances between the local vectors and their closest center
+// *************************************************************************
+float estimateClasses() {
+    float tot_min_distances = 0;
+
+    #pragma omp parallel for reduction(+:tot_min_distances) schedule(static)
+    for (int w=0; w<Local_N; w++) {
+        float min_dist = 1e30;
+		int temp_class = -1;
+
+        for (int i=0; i<Nc; i++) {
+            float dist = 0;
+
+            #pragma omp simd reduction(+:dist) // If <reduction> is omitted, the compiler protects from math error and does not perform SIMD
+            for (int j=0; j<Nv; j++)
+                dist += (Vectors[w][j]-Centers[i][j]) * (Vectors[w][j]-Centers[i][j]); // Distance between Vec and Center i
+
+            if (dist < min_dist) {
+                temp_class = i;
+                min_dist = dist;
+            }
+        }
+        Class_of_Vec[w] = temp_class; // Update the current vector's class with the new one
+        tot_min_distances += sqrt(min_dist); // Increase the sum of distances
+    }
+    return tot_min_distances;
+}
+
+
+// ***************************************************
+// Adds each local vector's values to its corresponding center sum
+// ***************************************************
+void sumLocalCenters() {
+    memset(Thread_Sums, 0, sizeof(double) * Threads * Nc * Nv);
+    memset(Thread_Matchings, 0, sizeof(int) * Threads * Nc);
+
+    // Each thread adds its vectors to its own accumulators
+    #pragma omp parallel num_threads(Threads)
+    {
+        int thread = omp_get_thread_num();
+        #pragma omp for schedule(static)
+        for (int w = 0; w < Local_N; w ++) {
+            double *Sum = &Thread_Sums[((size_t)thread*Nc + Class_of_Vec[w])*Nv];
+            Thread_Matchings[thread*Nc + Class_of_Vec[w]] ++;
+            #pragma omp simd
+            for (int j = 0; j<Nv; j++)
+                Sum[j] += Vectors[w][j];
+        }
+    }
+
+    // Merge the accumulators of the threads
+    #pragma omp parallel for schedule(static) num_threads(Threads)
+    for (int i = 0; i < Nc; i++) {
+        Centers_matchings[i] = 0;
+        for (int t = 0; t < Threads; t++)
+            Centers_matchings[i] += Thread_Matchings[t*Nc + i];
+        for (int j = 0; j < Nv; j++) {
+            double sum = 0;
+            for (int t = 0; t < Threads; t++)
+                sum += Thread_Sums[((size_t)t*Nc + i)*Nv + j];
+            Center_Sums[i][j] = sum;
+        }
+    }
+}
+
+
+// ***************************************************
+// Find the new centers from the global sums and matchings
+// ***************************************************
+void estimateCenters() {
+	for (int i = 0; i < Nc; i++) {
+		if (Centers_matchings[i] != 0)
+			for (int j = 0; j < Nv; j++)
+				Centers[i][j] = Center_Sums[i][j] / Centers_matchings[i];
+		else {
+			if (Rank == 0) printf("\nWARNING: Center %d has no members.\n", i);
+            pickSubstituteCenter(i);
+        }
+	}
+}
+
+
+// ***************************************************
+// Philox4x32-10 on <PHILOX_LANES> consecutive counters (<a>, <first_b>+lane, 0, 0).
+// Word k of the result of each lane is stored in Out[k][lane]; the loops over the lanes are vectorized
+// ***************************************************
+static inline void philoxLanes(uint32_t a, uint32_t first_b, uint32_t Out[4][PHILOX_LANES]) {
+    uint32_t key0 = (uint32_t) DATA_SEED, key1 = (uint32_t)((uint64_t) DATA_SEED >> 32);
+
+    #pragma omp simd
+    for (int l=0; l<PHILOX_LANES; l++) {
+        Out[0][l] = a; Out[1][l] = first_b + l; Out[2][l] = 0; Out[3][l] = 0;
+    }
+    for (int round=0; round<10; round++) {
+        #pragma omp simd
+        for (int l=0; l<PHILOX_LANES; l++) {
+            uint64_t product0 = (uint64_t) PHILOX_M0 * Out[0][l];
+            uint64_t product1 = (uint64_t) PHILOX_M1 * Out[2][l];
+            uint32_t c0 = (uint32_t)(product1 >> 32) ^ Out[1][l] ^ key0;
+            uint32_t c2 = (uint32_t)(product0 >> 32) ^ Out[3][l] ^ key1;
+            Out[0][l] = c0; Out[1][l] = (uint32_t) product1; Out[2][l] = c2; Out[3][l] = (uint32_t) product0;
+        }
+        key0 += PHILOX_W0; key1 += PHILOX_W1;
+    }
+}
+
+
+// ***************************************************
+// Initializing the local vectors with random values in [0,1): element e of global vector i comes from counter (i, e/4)
+// ***************************************************
+void SetVec( void ) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0 ; i< Local_N ; i++ ) {
+        uint32_t Random[4][PHILOX_LANES];
+        for (int e0 = 0; e0 < Nv; e0 += 4*PHILOX_LANES) {
+            philoxLanes(First_Vec + i, e0/4, Random);
+            for (int e = e0; e < e0 + 4*PHILOX_LANES && e < Nv; e++)
+                Vectors[i][e] = (Random[(e-e0)%4][(e-e0)/4] >> 8) * (1.0f/16777216.0f);
+        }
+    }
+}
+
+
+// ***************************************************
+// Prints the timings of all ranks (max and average per phase, imbalance)
+// ***************************************************
+void printScalingReport(int repetitions, double totalTime) {
+    double maxTimes[NUM_OF_PHASES], sumTimes[NUM_OF_PHASES], maxTotal;
+    MPI_Reduce(Phase_Times, maxTimes, NUM_OF_PHASES, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(Phase_Times, sumTimes, NUM_OF_PHASES, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&totalTime, &maxTotal, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (Rank != 0) return;
+
+    printf("\n------------------------------- Scaling report -------------------------------\n");
+    printf("Ranks: %d   Threads per rank: %d   Vectors per rank: ~%d\n", Ranks, omp_get_max_threads(), N/Ranks);
+    printf("%-24s %12s %12s %12s\n", "Phase", "max (s)", "avg (s)", "imbalance");
+    for (int p=0; p<NUM_OF_PHASES; p++) {
+        double avg = sumTimes[p]/Ranks;
+        printf("%-24s %12.4lf %12.4lf %11.2lf%%\n", Phase_Names[p], maxTimes[p], avg, (avg>0) ? 100*(maxTimes[p]/avg-1) : 0.0);
+    }
+    printf("%-24s %12.4lf\n", "main algorithm", maxTotal);
+    printf("%-24s %12.4lf\n", "per repetition", maxTotal/repetitions);
+    printf("------------------------------------------------------------------------------\n");
+    printf("SCALING: ranks=%d threads=%d repetitions=%d total=%.4lf compute=%.4lf allreduce=%.4lf\n",
+        Ranks, omp_get_max_threads(), repetitions, maxTotal, maxTimes[PHASE_COMPUTE], maxTimes[PHASE_ALLREDUCE]);
+}
+
+
+// ***************************************************
+// The main program
+// ***************************************************
+int main( int argc, char* argv[] ) {
+    int repetitions = 0, provided;
+    float totDist, prevDist, diff;
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &Ranks);
+
+    // Contiguous shards, the first N%Ranks ranks get one more vector
+    Local_N = N/Ranks + (Rank < N%Ranks);
+    First_Vec = Rank*(N/Ranks) + (Rank < N%Ranks ? Rank : N%Ranks);
+    Vectors = malloc(sizeof(float) * (size_t)Local_N * Nv);
+    Class_of_Vec = malloc(sizeof(int) * (Local_N > 0 ? Local_N : 1));
+    Threads = omp_get_max_threads();
+    Thread_Sums = malloc(sizeof(double) * Threads * Nc * Nv);
+    Thread_Matchings = malloc(sizeof(int) * Threads * Nc);
+    if (Vectors == NULL || Class_of_Vec == NULL || Thread_Sums == NULL || Thread_Matchings == NULL) { printf("ERROR: Rank %d is out of memory\n", Rank); MPI_Abort(MPI_COMM_WORLD, 1); }
+
+    if (Rank == 0) {
+        printf("--------------------------------------------------------------------------------------------------\n");
+        printf("This program executes the K-Means algorithm for random vectors of arbitrary number and dimensions.\n");
+        printf("Current configuration has %d Vectors, %d Classes and %d Elements per vector.\n", N, Nc, Nv);
+        printf("The vectors are distributed over %d MPI ranks with %d OpenMP threads each.\n", Ranks, omp_get_max_threads());
+        printf("--------------------------------------------------------------------------------------------------\n");
+        printf("Now initializing vectors...\n");
+    }
+    SetVec() ;
+
+    if (Rank == 0) printf("Now initializing centers...\n");
+    initCenters2() ;
+
+	totDist = 1.0e30;
+    if (Rank == 0) printf("Now running the main algorithm...\n\n");
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    do {
+        repetitions++;
+        prevDist = totDist ;
+
+        double t0 = MPI_Wtime();
+        double localDist = estimateClasses(), globalDist;
+        sumLocalCenters() ;
+        double t1 = MPI_Wtime();
+        MPI_Allreduce(MPI_IN_PLACE, Center_Sums, Nc*Nv, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, Centers_matchings, Nc, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(&localDist, &globalDist, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        double t2 = MPI_Wtime();
+        estimateCenters() ;
+        double t3 = MPI_Wtime();
+        Phase_Times[PHASE_COMPUTE] += t1-t0; Phase_Times[PHASE_ALLREDUCE] += t2-t1; Phase_Times[PHASE_UPDATE] += t3-t2;
+
+        totDist = globalDist;
+        diff = (prevDist-totDist)/totDist ;
+
+        if (Rank == 0) {
+            printf(">> REPETITION: %3d  ||  ", repetitions);
+            printf("DISTANCE IMPROVEMENT: %.6f \n", diff);
+        }
+    } while( (diff > THRESHOLD) && (repetitions < MAX_REPETITIONS) ) ;
+    double totalTime = MPI_Wtime() - start;
+
+    if (Rank == 0) {
+        printf("\n\nProcess finished!\n");
+        printf("Total repetitions were: %d\n", repetitions);
+    }
+    printScalingReport(repetitions, totalTime);
+
+    free(Vectors); free(Class_of_Vec); free(Thread_Sums); free(Thread_Matchings);
+    MPI_Finalize();
+    return 0 ;
+}
+
+//**********************************************************************************************************
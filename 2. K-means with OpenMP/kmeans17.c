@@ -0,0 +1,387 @@
+/*
+Description:
+    This program executes the K-Means algorithm for random vectors of arbitrary number
+    and dimensions 
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles with: gcc kmeans17.c -o kmeans17 -lm -fopt-info -fopenmp -O3
+    Runs with: ./kmeans17 [output_prefix]
+    Inherits all settings of kmeans15 unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> printVectors(), printCenters() and printClasses() (one printf() per value) were replaced by a binary output stage:
+        <prefix>_centers.npy (float32, Nc x Nv) and <prefix>_classes.npy (int32, N), readable with numpy.load()
+    --> Optional per-vector distances from the assigned center (WRITE_DISTANCES 1): <prefix>_distances.npy (float32, N)
+    --> Optional CSV copies (WRITE_CSV 1): <prefix>_centers.csv and <prefix>_classes.csv
+    --> Every file is written through a stdio buffer of <OUTPUT_BUFFER_SIZE> bytes; the .npy payloads are written with a single fwrite()
+    --> Classes and distances are estimated once more after the last repetition, so all files refer to the written centers
+
+*/
+
+// ******************************************************************* 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline", "unsafe-math-optimizations") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// ******************************************************************* 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+// ***************************************************
+#define N  100000
+#define Nv 1000
+#define Nc 100
+#define THRESHOLD 0.000001
+#define MAX_REPETITIONS 16
+
+#define REPRODUCIBLE_REDUCTION 1 // 1: thread-count independent sum of distances, 0: fast OpenMP reduction
+#define REDUCTION_BLOCK 256      // Vectors per block of the reproducible reduction (must not depend on the thread count)
+#define NUM_OF_BLOCKS ((N+REDUCTION_BLOCK-1)/REDUCTION_BLOCK)
+
+#define WRITE_DISTANCES 1 // 1: also write the distance of each vector from its center
+#define WRITE_CSV 0       // 1: also write CSV copies of the centers and the classes
+#define OUTPUT_BUFFER_SIZE (8*1024*1024)
+#define DEFAULT_OUTPUT_PREFIX "kmeans17"
+
+// ***************************************************
+float Vectors[N][Nv]; // N vectors of Nv dimensions
+float Centers[Nc][Nv]; // Nc vectors of Nv dimensions
+int   Class_of_Vec[N]; // Class of each Vector
+float Distance_of_Vec[N]; // Distance of each Vector from the center of its class
+double Block_Distances[NUM_OF_BLOCKS]; // Sum of distances of each block of vectors (reproducible reduction)
+
+
+
+// ***************************************************
+// Opens <prefix><suffix> for writing with a large stdio buffer
+// ***************************************************
+FILE *openOutputFile(const char *prefix, const char *suffix, char **buffer) {
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s%s", prefix, suffix);
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) { perror(filename); exit(1); }
+    *buffer = malloc(OUTPUT_BUFFER_SIZE);
+    if (*buffer != NULL) setvbuf(file, *buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+    return file;
+}
+
+
+// ***************************************************
+// Closes a file opened by openOutputFile()
+// ***************************************************
+void closeOutputFile(FILE *file, char *buffer) {
+    if (fclose(file) != 0) { perror("fclose"); exit(1); }
+    free(buffer);
+}
+
+
+// ***************************************************
+// Writes a 1D or 2D array in NPY format (version 1.0, little-endian <descr> such as "<f4" or "<i4")
+// ***************************************************
+void writeNPY(const char *prefix, const char *suffix, const char *descr, const void *Data, size_t elemSize, int rows, int cols) {
+    char header[128], *buffer;
+    int len;
+    if (cols > 0) len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%d, %d), }", descr, rows, cols);
+    else len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%d,), }", descr, rows);
+    int total = (10 + len + 1 + 63) / 64 * 64; // Magic (6) + version (2) + header length (2) + header + '\n', aligned to 64 bytes
+    memset(header + len, ' ', total - 10 - len - 1);
+    header[total - 10 - 1] = '\n';
+    unsigned short headerLen = total - 10;
+
+    FILE *file = openOutputFile(prefix, suffix, &buffer);
+    fwrite("\x93NUMPY\x01\x00", 1, 8, file);
+    unsigned char lenBytes[2] = { headerLen & 0xFF, headerLen >> 8 };
+    fwrite(lenBytes, 1, 2, file);
+    fwrite(header, 1, headerLen, file);
+    size_t count = (size_t) rows * (cols > 0 ? cols : 1);
+    if (fwrite(Data, elemSize, count, file) != count) { perror(suffix); exit(1); }
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes the centers as CSV (one center per line)
+// ***************************************************
+void writeCentersCSV(const char *prefix) {
+    char *buffer;
+    FILE *file = openOutputFile(prefix, "_centers.csv", &buffer);
+	for (int i = 0; i < Nc; i++)
+		for (int j = 0; j < Nv; j++)
+			fprintf(file, (j < Nv-1) ? "%f," : "%f\n", Centers[i][j]);
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes the class (and distance) of each vector as CSV
+// ***************************************************
+void writeClassesCSV(const char *prefix) {
+    char *buffer;
+    FILE *file = openOutputFile(prefix, "_classes.csv", &buffer);
+    fprintf(file, WRITE_DISTANCES ? "vector,class,distance\n" : "vector,class\n");
+	for (int i = 0; i < N; i++) {
+        if (WRITE_DISTANCES) fprintf(file, "%d,%d,%f\n", i, Class_of_Vec[i], Distance_of_Vec[i]);
+        else fprintf(file, "%d,%d\n", i, Class_of_Vec[i]);
+    }
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes all the results, files start with <prefix>
+// ***************************************************
+void writeResults(const char *prefix) {
+    writeNPY(prefix, "_centers.npy", "<f4", Centers, sizeof(float), Nc, Nv);
+    writeNPY(prefix, "_classes.npy", "<i4", Class_of_Vec, sizeof(int), N, 0);
+    if (WRITE_DISTANCES) writeNPY(prefix, "_distances.npy", "<f4", Distance_of_Vec, sizeof(float), N, 0);
+    if (WRITE_CSV) {
+        writeCentersCSV(prefix);
+        writeClassesCSV(prefix);
+    }
+}
+
+
+// ****************************************************
+// Returns 1 if a Vector is not in an array of vectors
+// ****************************************************
+int notVectorInCenters(float Vec[Nv], int maxIndex) {
+
+    // Examining all the centers until <maxIndex>
+    //printf("\nChecking if vec is in centers...\n");
+    for (int c=0; c<maxIndex; c++) {
+        //printf("> Checking center %d...\n", c);
+        int flag = 1; 
+        for (int i=0; i<Nv; i++) {
+            //printf(">> Checking dim %d...\n", i);
+            
+            if (Vec[i] != Centers[c][i]) {
+                //printf(">>> This dimension is different, so no need to keep checking this center.\n");
+                flag = 0;
+                break;
+            }
+        }
+        if (flag)     // If <flag> remains equal to 1, then the vector <Vec> is equal to current examined center <c>
+            return 0; // So <Vec> is unsuitable to become a new Center
+
+    }
+
+    return 1;
+}
+
+
+// ****************************************************
+// Picks a new center when the last one has no neighbours
+// ****************************************************
+void pickSubstituteCenter(int indexOfCenterToChange){
+    int currentVec = 0;
+
+    // Searching for a vector that is not a center, so as to mark it as one
+    printf("> Now searching for a substitute center...\n");
+    do {
+        printf(">> Now examining vec:%d\n", currentVec);
+        if (notVectorInCenters(Vectors[currentVec], Nc)) {
+            printf(">>> Current vec is not in existing centers\n");
+            for (int i=0; i<Nv; i++) 
+                Centers[indexOfCenterToChange][i] = Vectors[currentVec][i];  
+                
+            printf(">>> Substituted old center with current vector\n");
+            return;    // If a substitute center is found, stop this function             
+        }
+            
+        printf(">>> WARNING: If the center was substituted, this line must not be present\n");
+        currentVec ++; // else contunue searching
+    } while (currentVec<N);
+
+    printf("\n");
+    return;
+}
+
+
+// ****************************************************
+// Chooses the first unique Nc vectors as class centers
+// ****************************************************
+void initCenters2() {
+    int currentCenter=0, currentVec=0;
+    do {
+        if (notVectorInCenters(Vectors[currentVec], currentCenter)) {
+            for (int i=0; i<Nv; i++) 
+                Centers[currentCenter][i] = Vectors[currentVec][i];
+            currentCenter ++;                
+            }
+        currentVec++;
+    } while (currentCenter<Nc);
+}
+
+
+// *************************************************************************
+// Updates the class of vector <w> and returns its distance from the closest center
+// *************************************************************************
+static inline float classifyVector(int w) {
+    float min_dist = 1e30;
+	int temp_class = -1;
+
+    for (int i=0; i<Nc; i++) {
+        float dist = 0;
+
+        #pragma omp simd reduction(+:dist) // If <reduction> is omitted, the compiler protects from math error and does not perform SIMD 
+        for (int j=0; j<Nv; j++) 
+            dist += (Vectors[w][j]-Centers[i][j]) * (Vectors[w][j]-Centers[i][j]); // Distance between Vec and Center i
+
+        if (dist < min_dist) {
+            temp_class = i;
+            min_dist = dist;
+        }
+    }
+    Class_of_Vec[w] = temp_class; // Update the current vector's class with the new one
+    Distance_of_Vec[w] = sqrt(min_dist);
+    return Distance_of_Vec[w];
+}
+
+
+// *************************************************************************
+// Adds <count> values with pairwise summation (the order of additions depends only on <count>)
+// *************************************************************************
+double pairwiseSum(const double *Values, int count) {
+    if (count <= 8) {
+        double sum = 0;
+        for (int i=0; i<count; i++) sum += Values[i];
+        return sum;
+    }
+    int half = count/2;
+    return pairwiseSum(Values, half) + pairwiseSum(Values+half, count-half);
+}
+
+
+// *************************************************************************
+// Returns the sum of distances between all vectors and their closest center
+// *************************************************************************
+float estimateClasses() {
+#if REPRODUCIBLE_REDUCTION
+    // Each block is summed by a single thread in a fixed order, whichever thread that is
+    #pragma omp parallel for schedule(static)
+    for (int b=0; b<NUM_OF_BLOCKS; b++) {
+        int last = (b+1)*REDUCTION_BLOCK < N ? (b+1)*REDUCTION_BLOCK : N;
+        double block_distances = 0;
+        for (int w=b*REDUCTION_BLOCK; w<last; w++)
+            block_distances += classifyVector(w);
+        Block_Distances[b] = block_distances;
+    }
+    return pairwiseSum(Block_Distances, NUM_OF_BLOCKS);
+#else
+    float tot_min_distances = 0;
+	
+    #pragma omp parallel for reduction(+:tot_min_distances) schedule(static)
+    for (int w=0; w<N; w++) 
+        tot_min_distances += classifyVector(w); // Increase the sum of distances
+    return tot_min_distances;
+#endif
+}
+
+
+// ***************************************************
+// Find the new centers
+// ***************************************************
+void estimateCenters() {
+    int Centers_matchings[Nc] = {0};    
+    int needToRecalculateCenters = 0;
+
+    // Zero all center vectors
+	for (int i = 0; i < Nc; i++)
+		for (int j = 0; j < Nv; j++)
+			Centers[i][j] = 0;
+	
+    // Add each vector's values to its corresponding center
+    for (int w = 0; w < N; w ++) {
+        Centers_matchings[Class_of_Vec[w]] ++;
+        for (int j = 0; j<Nv; j++)
+            Centers[Class_of_Vec[w]][j] += Vectors[w][j];
+    }
+
+	for (int i = 0; i < Nc; i++) {
+		if (Centers_matchings[i] != 0)
+			for (int j = 0; j < Nv; j++)
+				Centers[i][j] /= Centers_matchings[i];
+		else {
+			printf("\nWARNING: Center %d has no members.\n", i);
+            pickSubstituteCenter(i);
+            needToRecalculateCenters = 1;
+            break;
+        }
+	}
+    if (needToRecalculateCenters == 1) estimateCenters();
+}
+
+
+// ***************************************************
+// Initializing the vectors with random values
+// ***************************************************
+void SetVec( void ) {
+    for(int i = 0 ; i< N ; i++ )
+        for(int j = 0 ; j< Nv ; j++ )
+
+            Vectors[i][j] =  (1.0*rand())/RAND_MAX ;
+}
+
+
+// ***************************************************
+// The main program
+// ***************************************************
+int main( int argc, const char* argv[] ) {
+    int repetitions = 0;
+    float totDist, prevDist, diff;
+    const char *outputPrefix = (argc>1) ? argv[1] : DEFAULT_OUTPUT_PREFIX;
+	printf("--------------------------------------------------------------------------------------------------\n");
+	printf("This program executes the K-Means algorithm for random vectors of arbitrary number and dimensions.\n");
+	printf("Current configuration has %d Vectors, %d Classes and %d Elements per vector.\n", N, Nc, Nv);
+	printf("--------------------------------------------------------------------------------------------------\n");
+    printf("Now initializing vectors...\n");
+    SetVec() ;
+    
+    printf("Now initializing centers...\n");
+    initCenters2() ;
+
+	totDist = 1.0e30;
+    printf("Now running the main algorithm (%s reduction, %d threads)...\n\n", REPRODUCIBLE_REDUCTION ? "reproducible" : "fast", omp_get_max_threads());
+    double start = omp_get_wtime();
+    do {
+        repetitions++; 
+        prevDist = totDist ;
+        
+        totDist = estimateClasses() ;
+        estimateCenters() ;
+        diff = (prevDist-totDist)/totDist ;
+
+        printf(">> REPETITION: %3d  ||  ", repetitions);
+        printf("DISTANCE IMPROVEMENT: %.6f \n", diff);
+    } while( (diff > THRESHOLD) && (repetitions < MAX_REPETITIONS) ) ;
+    totDist = estimateClasses() ; // Classes and distances of the final centers, the ones that are written
+
+    double elapsed = omp_get_wtime() - start;
+
+    printf("\n\nProcess finished!\n");
+	printf("Total repetitions were: %d\n", repetitions);
+	printf("Total distance is: %.6f\n", totDist);
+	printf("Main algorithm time: %.3lf seconds\n", elapsed);
+
+    printf("Now writing the results to %s_*...\n", outputPrefix);
+    start = omp_get_wtime();
+    writeResults(outputPrefix) ;
+	printf("Results written in %.3lf seconds\n", omp_get_wtime() - start);
+    return 0 ;
+}
+
+//**********************************************************************************************************
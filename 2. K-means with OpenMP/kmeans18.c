@@ -0,0 +1,580 @@
+/*
+Description:
+    This program executes the K-Means algorithm for random vectors of arbitrary number
+    and dimensions 
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles with: gcc kmeans18.c -o kmeans18 -lm -fopt-info -fopenmp -O3
+    Runs with: ./kmeans18 [--autotune] [output_prefix]
+    Inherits all settings of kmeans17 unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> The loop of estimateClasses() uses schedule(runtime), so its schedule kind, chunk size and thread count are chosen at run time
+    --> Vectors are classified in tiles of <Vector_Tile> vectors (classifyTile()): each center row is loaded once per tile.
+        The distance of each vector is computed exactly as before, so the results do not depend on the tile size
+    --> Autotune mode: estimateClasses() is timed on the first <AUTOTUNE_SAMPLE> vectors for every thread count (max, max/2, ..., 1),
+        then for every schedule kind and chunk size, then for every tile size (each stage keeps the best value of the previous ones)
+    --> The best configuration is stored in <TUNING_FILE>, one line per program (<TUNING_PROGRAM>), CPU model and problem shape
+        (N, Nv, Nc, reduction mode)
+    --> Every run looks up its program, CPU model and problem shape in <TUNING_FILE> and applies the stored configuration;
+        the autotuner runs automatically when no entry exists, or always with --autotune
+    With REPRODUCIBLE_REDUCTION 1 the chunk size counts blocks of <REDUCTION_BLOCK> vectors, so the results stay independent of the tuned values
+
+*/
+
+// ******************************************************************* 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline", "unsafe-math-optimizations") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// ******************************************************************* 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+// ***************************************************
+#define N  100000
+#define Nv 1000
+#define Nc 100
+#define THRESHOLD 0.000001
+#define MAX_REPETITIONS 16
+
+#define REPRODUCIBLE_REDUCTION 1 // 1: thread-count independent sum of distances, 0: fast OpenMP reduction
+#define REDUCTION_BLOCK 256      // Vectors per block of the reproducible reduction (must not depend on the thread count)
+#define NUM_OF_BLOCKS ((N+REDUCTION_BLOCK-1)/REDUCTION_BLOCK)
+
+#define WRITE_DISTANCES 1 // 1: also write the distance of each vector from its center
+#define WRITE_CSV 0       // 1: also write CSV copies of the centers and the classes
+#define OUTPUT_BUFFER_SIZE (8*1024*1024)
+#define DEFAULT_OUTPUT_PREFIX "kmeans18"
+
+#define TUNING_FILE "kmeans_tuning.cfg"
+#define TUNING_PROGRAM "kmeans18" // First field of the key: the versions share <TUNING_FILE> but not their kernels
+#define AUTOTUNE_SAMPLE 4096 // Vectors used to time each configuration
+#define AUTOTUNE_RUNS 3      // Timed runs per configuration (the fastest one is kept)
+#define MAX_TILE 16
+
+// ***************************************************
+float Vectors[N][Nv]; // N vectors of Nv dimensions
+float Centers[Nc][Nv]; // Nc vectors of Nv dimensions
+int   Class_of_Vec[N]; // Class of each Vector
+float Distance_of_Vec[N]; // Distance of each Vector from the center of its class
+
+int Vector_Tile = 1; // Vectors classified together by classifyTile()
+const int Tile_Options[] = {1, 2, 4, 8, 16};
+const omp_sched_t Schedule_Options[] = {omp_sched_static, omp_sched_dynamic, omp_sched_guided};
+const char *Schedule_Names[] = {"", "static", "dynamic", "guided", "auto"}; // Indexed by omp_sched_t
+#if REPRODUCIBLE_REDUCTION
+const int Chunk_Options[] = {0, 1, 2, 4, 8}; // In blocks (0 is the default chunk of each schedule kind)
+#else
+const int Chunk_Options[] = {0, 16, 64, 256, 1000}; // In vectors (0 is the default chunk of each schedule kind)
+#endif
+double Block_Distances[NUM_OF_BLOCKS]; // Sum of distances of each block of vectors (reproducible reduction)
+
+
+
+// ***************************************************
+// Opens <prefix><suffix> for writing with a large stdio buffer
+// ***************************************************
+FILE *openOutputFile(const char *prefix, const char *suffix, char **buffer) {
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s%s", prefix, suffix);
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) { perror(filename); exit(1); }
+    *buffer = malloc(OUTPUT_BUFFER_SIZE);
+    if (*buffer != NULL) setvbuf(file, *buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+    return file;
+}
+
+
+// ***************************************************
+// Closes a file opened by openOutputFile()
+// ***************************************************
+void closeOutputFile(FILE *file, char *buffer) {
+    if (fclose(file) != 0) { perror("fclose"); exit(1); }
+    free(buffer);
+}
+
+
+// ***************************************************
+// Writes a 1D or 2D array in NPY format (version 1.0, little-endian <descr> such as "<f4" or "<i4")
+// ***************************************************
+void writeNPY(const char *prefix, const char *suffix, const char *descr, const void *Data, size_t elemSize, int rows, int cols) {
+    char header[128], *buffer;
+    int len;
+    if (cols > 0) len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%d, %d), }", descr, rows, cols);
+    else len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%d,), }", descr, rows);
+    int total = (10 + len + 1 + 63) / 64 * 64; // Magic (6) + version (2) + header length (2) + header + '\n', aligned to 64 bytes
+    memset(header + len, ' ', total - 10 - len - 1);
+    header[total - 10 - 1] = '\n';
+    unsigned short headerLen = total - 10;
+
+    FILE *file = openOutputFile(prefix, suffix, &buffer);
+    fwrite("\x93NUMPY\x01\x00", 1, 8, file);
+    unsigned char lenBytes[2] = { headerLen & 0xFF, headerLen >> 8 };
+    fwrite(lenBytes, 1, 2, file);
+    fwrite(header, 1, headerLen, file);
+    size_t count = (size_t) rows * (cols > 0 ? cols : 1);
+    if (fwrite(Data, elemSize, count, file) != count) { perror(suffix); exit(1); }
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes the centers as CSV (one center per line)
+// ***************************************************
+void writeCentersCSV(const char *prefix) {
+    char *buffer;
+    FILE *file = openOutputFile(prefix, "_centers.csv", &buffer);
+	for (int i = 0; i < Nc; i++)
+		for (int j = 0; j < Nv; j++)
+			fprintf(file, (j < Nv-1) ? "%f," : "%f\n", Centers[i][j]);
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes the class (and distance) of each vector as CSV
+// ***************************************************
+void writeClassesCSV(const char *prefix) {
+    char *buffer;
+    FILE *file = openOutputFile(prefix, "_classes.csv", &buffer);
+    fprintf(file, WRITE_DISTANCES ? "vector,class,distance\n" : "vector,class\n");
+	for (int i = 0; i < N; i++) {
+        if (WRITE_DISTANCES) fprintf(file, "%d,%d,%f\n", i, Class_of_Vec[i], Distance_of_Vec[i]);
+        else fprintf(file, "%d,%d\n", i, Class_of_Vec[i]);
+    }
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes all the results, files start with <prefix>
+// ***************************************************
+void writeResults(const char *prefix) {
+    writeNPY(prefix, "_centers.npy", "<f4", Centers, sizeof(float), Nc, Nv);
+    writeNPY(prefix, "_classes.npy", "<i4", Class_of_Vec, sizeof(int), N, 0);
+    if (WRITE_DISTANCES) writeNPY(prefix, "_distances.npy", "<f4", Distance_of_Vec, sizeof(float), N, 0);
+    if (WRITE_CSV) {
+        writeCentersCSV(prefix);
+        writeClassesCSV(prefix);
+    }
+}
+
+
+// ****************************************************
+// Returns 1 if a Vector is not in an array of vectors
+// ****************************************************
+int notVectorInCenters(float Vec[Nv], int maxIndex) {
+
+    // Examining all the centers until <maxIndex>
+    //printf("\nChecking if vec is in centers...\n");
+    for (int c=0; c<maxIndex; c++) {
+        //printf("> Checking center %d...\n", c);
+        int flag = 1; 
+        for (int i=0; i<Nv; i++) {
+            //printf(">> Checking dim %d...\n", i);
+            
+            if (Vec[i] != Centers[c][i]) {
+                //printf(">>> This dimension is different, so no need to keep checking this center.\n");
+                flag = 0;
+                break;
+            }
+        }
+        if (flag)     // If <flag> remains equal to 1, then the vector <Vec> is equal to current examined center <c>
+            return 0; // So <Vec> is unsuitable to become a new Center
+
+    }
+
+    return 1;
+}
+
+
+// ****************************************************
+// Picks a new center when the last one has no neighbours
+// ****************************************************
+void pickSubstituteCenter(int indexOfCenterToChange){
+    int currentVec = 0;
+
+    // Searching for a vector that is not a center, so as to mark it as one
+    printf("> Now searching for a substitute center...\n");
+    do {
+        printf(">> Now examining vec:%d\n", currentVec);
+        if (notVectorInCenters(Vectors[currentVec], Nc)) {
+            printf(">>> Current vec is not in existing centers\n");
+            for (int i=0; i<Nv; i++) 
+                Centers[indexOfCenterToChange][i] = Vectors[currentVec][i];  
+                
+            printf(">>> Substituted old center with current vector\n");
+            return;    // If a substitute center is found, stop this function             
+        }
+            
+        printf(">>> WARNING: If the center was substituted, this line must not be present\n");
+        currentVec ++; // else contunue searching
+    } while (currentVec<N);
+
+    printf("\n");
+    return;
+}
+
+
+// ****************************************************
+// Chooses the first unique Nc vectors as class centers
+// ****************************************************
+void initCenters2() {
+    int currentCenter=0, currentVec=0;
+    do {
+        if (notVectorInCenters(Vectors[currentVec], currentCenter)) {
+            for (int i=0; i<Nv; i++) 
+                Centers[currentCenter][i] = Vectors[currentVec][i];
+            currentCenter ++;                
+            }
+        currentVec++;
+    } while (currentCenter<Nc);
+}
+
+
+// *************************************************************************
+// Updates the classes of the <count> vectors starting from <first> and their distances from the closest center
+// *************************************************************************
+static inline void classifyTile(int first, int count) {
+    float min_dist[MAX_TILE];
+	int temp_class[MAX_TILE];
+    for (int t=0; t<count; t++) { min_dist[t] = 1e30; temp_class[t] = -1; }
+
+    for (int i=0; i<Nc; i++) {
+        for (int t=0; t<count; t++) { // Center i stays in cache for all the vectors of the tile
+            float dist = 0;
+
+            #pragma omp simd reduction(+:dist) // If <reduction> is omitted, the compiler protects from math error and does not perform SIMD 
+            for (int j=0; j<Nv; j++) 
+                dist += (Vectors[first+t][j]-Centers[i][j]) * (Vectors[first+t][j]-Centers[i][j]); // Distance between Vec and Center i
+
+            if (dist < min_dist[t]) {
+                temp_class[t] = i;
+                min_dist[t] = dist;
+            }
+        }
+    }
+    for (int t=0; t<count; t++) {
+        Class_of_Vec[first+t] = temp_class[t]; // Update the current vector's class with the new one
+        Distance_of_Vec[first+t] = sqrt(min_dist[t]);
+    }
+}
+
+
+// *************************************************************************
+// Adds <count> values with pairwise summation (the order of additions depends only on <count>)
+// *************************************************************************
+double pairwiseSum(const double *Values, int count) {
+    if (count <= 8) {
+        double sum = 0;
+        for (int i=0; i<count; i++) sum += Values[i];
+        return sum;
+    }
+    int half = count/2;
+    return pairwiseSum(Values, half) + pairwiseSum(Values+half, count-half);
+}
+
+
+// *************************************************************************
+// Returns the sum of distances between the first <count> vectors and their closest center
+// *************************************************************************
+float estimateClasses(int count) {
+#if REPRODUCIBLE_REDUCTION
+    // Each block is summed by a single thread in a fixed order, whichever thread that is
+    int blocks = (count+REDUCTION_BLOCK-1)/REDUCTION_BLOCK;
+    #pragma omp parallel for schedule(runtime)
+    for (int b=0; b<blocks; b++) {
+        int last = (b+1)*REDUCTION_BLOCK < count ? (b+1)*REDUCTION_BLOCK : count;
+        double block_distances = 0;
+        for (int w=b*REDUCTION_BLOCK; w<last; w+=Vector_Tile)
+            classifyTile(w, (w+Vector_Tile < last) ? Vector_Tile : last-w);
+        for (int w=b*REDUCTION_BLOCK; w<last; w++)
+            block_distances += Distance_of_Vec[w];
+        Block_Distances[b] = block_distances;
+    }
+    return pairwiseSum(Block_Distances, blocks);
+#else
+    float tot_min_distances = 0;
+	
+    #pragma omp parallel for reduction(+:tot_min_distances) schedule(runtime)
+    for (int w=0; w<count; w+=Vector_Tile) {
+        int tile = (w+Vector_Tile < count) ? Vector_Tile : count-w;
+        classifyTile(w, tile);
+        for (int t=0; t<tile; t++)
+            tot_min_distances += Distance_of_Vec[w+t]; // Increase the sum of distances
+    }
+    return tot_min_distances;
+#endif
+}
+
+
+// ***************************************************
+// Find the new centers
+// ***************************************************
+void estimateCenters() {
+    int Centers_matchings[Nc] = {0};    
+    int needToRecalculateCenters = 0;
+
+    // Zero all center vectors
+	for (int i = 0; i < Nc; i++)
+		for (int j = 0; j < Nv; j++)
+			Centers[i][j] = 0;
+	
+    // Add each vector's values to its corresponding center
+    for (int w = 0; w < N; w ++) {
+        Centers_matchings[Class_of_Vec[w]] ++;
+        for (int j = 0; j<Nv; j++)
+            Centers[Class_of_Vec[w]][j] += Vectors[w][j];
+    }
+
+	for (int i = 0; i < Nc; i++) {
+		if (Centers_matchings[i] != 0)
+			for (int j = 0; j < Nv; j++)
+				Centers[i][j] /= Centers_matchings[i];
+		else {
+			printf("\nWARNING: Center %d has no members.\n", i);
+            pickSubstituteCenter(i);
+            needToRecalculateCenters = 1;
+            break;
+        }
+	}
+    if (needToRecalculateCenters == 1) estimateCenters();
+}
+
+
+// ***************************************************
+// Initializing the vectors with random values
+// ***************************************************
+void SetVec( void ) {
+    for(int i = 0 ; i< N ; i++ )
+        for(int j = 0 ; j< Nv ; j++ )
+
+            Vectors[i][j] =  (1.0*rand())/RAND_MAX ;
+}
+
+
+// ***************************************************
+// Returns the CPU model name (from /proc/cpuinfo) in <Model>
+// ***************************************************
+void getCpuModel(char *Model, int size) {
+    char line[512];
+    snprintf(Model, size, "unknown-cpu");
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (file == NULL) return;
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "model name", 10) == 0 && strchr(line, ':')) {
+            char *name = strchr(line, ':') + 1;
+            while (*name == ' ') name++;
+            name[strcspn(name, "\t\n")] = '\0';
+            snprintf(Model, size, "%s", name);
+            break;
+        }
+    }
+    fclose(file);
+}
+
+
+// ***************************************************
+// Writes the key of the current program, CPU and problem shape to <Key>
+// ***************************************************
+void getTuningKey(char *Key, int size) {
+    char model[256];
+    getCpuModel(model, sizeof(model));
+    snprintf(Key, size, "%s\t%s\t%d\t%d\t%d\t%s", TUNING_PROGRAM, model, N, Nv, Nc, REPRODUCIBLE_REDUCTION ? "reproducible" : "fast");
+}
+
+
+// ***************************************************
+// Applies a configuration to the OpenMP runtime and the classification kernel
+// ***************************************************
+void applyConfiguration(int threads, omp_sched_t kind, int chunk, int tile) {
+    omp_set_num_threads(threads);
+    omp_set_schedule(kind, chunk);
+    Vector_Tile = tile;
+}
+
+
+// ***************************************************
+// Looks up the current key in <TUNING_FILE> and applies its configuration. Returns 1 if it was found
+// ***************************************************
+int loadTuning() {
+    char key[512], line[1024];
+    getTuningKey(key, sizeof(key));
+    FILE *file = fopen(TUNING_FILE, "r");
+    if (file == NULL) return 0;
+
+    int found = 0;
+    size_t keyLen = strlen(key);
+    while (!found && fgets(line, sizeof(line), file)) {
+        int threads, kind, chunk, tile;
+        if (strncmp(line, key, keyLen) != 0 || line[keyLen] != '\t') continue;
+        if (sscanf(line + keyLen + 1, "%d\t%d\t%d\t%d", &threads, &kind, &chunk, &tile) != 4) continue;
+        if (threads < 1 || kind < 1 || kind > 4 || tile < 1 || tile > MAX_TILE) continue;
+        applyConfiguration(threads, (omp_sched_t) kind, chunk, tile);
+        printf("Loaded tuned configuration from %s: threads=%d schedule=%s chunk=%d tile=%d\n",
+            TUNING_FILE, threads, Schedule_Names[kind], chunk, tile);
+        found = 1;
+    }
+    fclose(file);
+    return found;
+}
+
+
+// ***************************************************
+// Replaces (or adds) the entry of the current key in <TUNING_FILE>
+// ***************************************************
+void saveTuning(int threads, omp_sched_t kind, int chunk, int tile, double seconds) {
+    char key[512], line[1024];
+    getTuningKey(key, sizeof(key));
+    size_t keyLen = strlen(key), kept = 0, capacity = 4096;
+    char *others = malloc(capacity);
+    if (others == NULL) { printf("WARNING: Not enough memory to save the tuned configuration\n"); return; }
+    others[0] = '\0';
+
+    // Keep the entries of other keys
+    FILE *file = fopen(TUNING_FILE, "r");
+    if (file != NULL) {
+        while (fgets(line, sizeof(line), file)) {
+            if (strncmp(line, key, keyLen) == 0 && line[keyLen] == '\t') continue;
+            size_t len = strlen(line);
+            if (kept + len + 1 > capacity) {
+                char *larger = realloc(others, 2*(kept + len + 1));
+                if (larger == NULL) { printf("WARNING: Not enough memory to save the tuned configuration\n"); fclose(file); free(others); return; }
+                others = larger; capacity = 2*(kept + len + 1);
+            }
+            memcpy(others + kept, line, len + 1);
+            kept += len;
+        }
+        fclose(file);
+    }
+
+    file = fopen(TUNING_FILE, "w");
+    if (file == NULL) { perror(TUNING_FILE); free(others); return; }
+    fputs(others, file);
+    fprintf(file, "%s\t%d\t%d\t%d\t%d\t%.6lf\n", key, threads, (int) kind, chunk, tile, seconds);
+    fclose(file);
+    free(others);
+    printf("Tuned configuration saved to %s\n", TUNING_FILE);
+}
+
+
+// ***************************************************
+// Returns the fastest of <AUTOTUNE_RUNS> runs of estimateClasses() on the sample with the given configuration
+// ***************************************************
+double timeConfiguration(int threads, omp_sched_t kind, int chunk, int tile) {
+    double best = INFINITY;
+    int sample = (AUTOTUNE_SAMPLE < N) ? AUTOTUNE_SAMPLE : N;
+    applyConfiguration(threads, kind, chunk, tile);
+    for (int r=0; r<AUTOTUNE_RUNS; r++) {
+        double start = omp_get_wtime();
+        estimateClasses(sample);
+        double seconds = omp_get_wtime() - start;
+        if (seconds < best) best = seconds;
+    }
+    printf(">> threads=%2d schedule=%-7s chunk=%4d tile=%2d  ===> %.4lf s\n", threads, Schedule_Names[kind], chunk, tile, best);
+    return best;
+}
+
+
+// ***************************************************
+// Sweeps thread counts, schedule kinds, chunk sizes and tile sizes on a sample of the vectors (the centers must be initialized)
+// ***************************************************
+void autotune() {
+    int bestThreads = omp_get_max_threads(), bestChunk = 0, bestTile = 1;
+    omp_sched_t bestKind = omp_sched_static;
+    double bestSeconds = INFINITY, seconds;
+
+    printf("Now autotuning on %d vectors...\n", (AUTOTUNE_SAMPLE < N) ? AUTOTUNE_SAMPLE : N);
+    printf("> Thread counts:\n");
+    for (int threads = omp_get_max_threads(); threads >= 1; threads /= 2)
+        if ((seconds = timeConfiguration(threads, bestKind, bestChunk, bestTile)) < bestSeconds) { bestSeconds = seconds; bestThreads = threads; }
+
+    printf("> Schedule kinds and chunk sizes:\n");
+    for (size_t k = 0; k < sizeof(Schedule_Options)/sizeof(Schedule_Options[0]); k++)
+        for (size_t c = 0; c < sizeof(Chunk_Options)/sizeof(Chunk_Options[0]); c++)
+            if ((seconds = timeConfiguration(bestThreads, Schedule_Options[k], Chunk_Options[c], bestTile)) < bestSeconds) {
+                bestSeconds = seconds; bestKind = Schedule_Options[k]; bestChunk = Chunk_Options[c];
+            }
+
+    printf("> Tile sizes:\n");
+    for (size_t t = 0; t < sizeof(Tile_Options)/sizeof(Tile_Options[0]); t++)
+        if ((seconds = timeConfiguration(bestThreads, bestKind, bestChunk, Tile_Options[t])) < bestSeconds) { bestSeconds = seconds; bestTile = Tile_Options[t]; }
+
+    printf("Best configuration: threads=%d schedule=%s chunk=%d tile=%d (%.4lf s per sample)\n",
+        bestThreads, Schedule_Names[bestKind], bestChunk, bestTile, bestSeconds);
+    applyConfiguration(bestThreads, bestKind, bestChunk, bestTile);
+    saveTuning(bestThreads, bestKind, bestChunk, bestTile, bestSeconds);
+}
+
+
+// ***************************************************
+// The main program
+// ***************************************************
+int main( int argc, const char* argv[] ) {
+    int repetitions = 0;
+    float totDist, prevDist, diff;
+    const char *outputPrefix = DEFAULT_OUTPUT_PREFIX;
+    int forceAutotune = 0;
+    for (int a=1; a<argc; a++) {
+        if (strcmp(argv[a], "--autotune") == 0) forceAutotune = 1;
+        else outputPrefix = argv[a];
+    }
+	printf("--------------------------------------------------------------------------------------------------\n");
+	printf("This program executes the K-Means algorithm for random vectors of arbitrary number and dimensions.\n");
+	printf("Current configuration has %d Vectors, %d Classes and %d Elements per vector.\n", N, Nc, Nv);
+	printf("--------------------------------------------------------------------------------------------------\n");
+    printf("Now initializing vectors...\n");
+    SetVec() ;
+    
+    printf("Now initializing centers...\n");
+    initCenters2() ;
+
+    omp_set_schedule(omp_sched_static, 0); // Same as schedule(static) of the previous versions
+    if (forceAutotune || !loadTuning()) autotune();
+
+	totDist = 1.0e30;
+    printf("\nNow running the main algorithm (%s reduction, %d threads)...\n\n", REPRODUCIBLE_REDUCTION ? "reproducible" : "fast", omp_get_max_threads());
+    double start = omp_get_wtime();
+    do {
+        repetitions++; 
+        prevDist = totDist ;
+        
+        totDist = estimateClasses(N) ;
+        estimateCenters() ;
+        diff = (prevDist-totDist)/totDist ;
+
+        printf(">> REPETITION: %3d  ||  ", repetitions);
+        printf("DISTANCE IMPROVEMENT: %.6f \n", diff);
+    } while( (diff > THRESHOLD) && (repetitions < MAX_REPETITIONS) ) ;
+    totDist = estimateClasses(N) ; // Classes and distances of the final centers, the ones that are written
+
+    double elapsed = omp_get_wtime() - start;
+
+    printf("\n\nProcess finished!\n");
+	printf("Total repetitions were: %d\n", repetitions);
+	printf("Total distance is: %.6f\n", totDist);
+	printf("Main algorithm time: %.3lf seconds\n", elapsed);
+
+    printf("Now writing the results to %s_*...\n", outputPrefix);
+    start = omp_get_wtime();
+    writeResults(outputPrefix) ;
+	printf("Results written in %.3lf seconds\n", omp_get_wtime() - start);
+    return 0 ;
+}
+
+//**********************************************************************************************************
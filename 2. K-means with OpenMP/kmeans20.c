@@ -0,0 +1,901 @@
+/*
+Description:
+    This program executes the K-Means algorithm for random vectors of arbitrary number
+    and dimensions 
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles with: gcc kmeans20.c -o kmeans20 -lm -fopt-info -fopenmp -O3
+    Runs with: ./kmeans20 [--autotune] [output_prefix]
+    Inherits all settings of kmeans19 unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> The distance kernel was moved to squaredDistance(), which is used by classifyTile() and by the quality evaluation
+    --> Quality evaluation after the main algorithm (EVALUATE_QUALITY 1), based on the final classes and the means of their vectors:
+        --> Davies-Bouldin index (lower is better) and Calinski-Harabasz index (higher is better), O(N*Nv).
+            The means of the classes are summed by each thread over its block of vectors (row by row) and combined per class.
+            Pairs of classes with coincident means are skipped by Davies-Bouldin
+        --> Mean silhouette coefficient (from -1 to 1, higher is better), O(S*S*Nv/2) for S vectors:
+            the distances are computed in blocks of <QUALITY_BLOCK> x <QUALITY_BLOCK> vectors, so each block of
+            reference vectors stays in cache while it is compared with a whole block of vectors.
+            Each distance is computed once and added to the sums of both of its vectors
+    --> Sampled silhouette (SILHOUETTE_SAMPLE > 0): S = <SILHOUETTE_SAMPLE> vectors with a fixed stride over the data, used both as
+        points and as references. SILHOUETTE_SAMPLE 0 gives the exact silhouette over all N vectors (S = N, very slow for the default sizes)
+    --> The time of each evaluation is printed
+
+*/
+
+// ******************************************************************* 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline", "unsafe-math-optimizations") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// ******************************************************************* 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <omp.h>
+
+// ***************************************************
+#define N  100000
+#define Nv 1000
+#define Nc 100
+#define THRESHOLD 0.000001
+#define MAX_REPETITIONS 16
+
+#define REPRODUCIBLE_REDUCTION 1 // 1: thread-count independent sum of distances, 0: fast OpenMP reduction
+#define REDUCTION_BLOCK 256      // Vectors per block of the reproducible reduction (must not depend on the thread count)
+#define NUM_OF_BLOCKS ((N+REDUCTION_BLOCK-1)/REDUCTION_BLOCK)
+
+#define WRITE_DISTANCES 1 // 1: also write the distance of each vector from its center
+#define WRITE_CSV 0       // 1: also write CSV copies of the centers and the classes
+#define OUTPUT_BUFFER_SIZE (8*1024*1024)
+#define DEFAULT_OUTPUT_PREFIX "kmeans20"
+
+#define TUNING_FILE "kmeans_tuning.cfg"
+#define TUNING_PROGRAM "kmeans20" // First field of the key: the versions share <TUNING_FILE> but not their kernels
+#define AUTOTUNE_SAMPLE 4096 // Vectors used to time each configuration
+#define AUTOTUNE_RUNS 3      // Timed runs per configuration (the fastest one is kept)
+#define MAX_TILE 16
+
+#define DATASET_UNIFORM 0 // Uniform values in [0,1)
+#define DATASET_BLOBS   1 // Gaussian blobs with known ground truth
+#define DATASET DATASET_BLOBS
+#define DATA_SEED 1046900
+#define BLOBS Nc
+#define BLOB_STDDEV 0.1
+
+// Philox4x32-10 constants (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_LANES 8 // Counters generated together by philoxLanes()
+#define STREAM_VECTORS 0 // Third counter word: separates the value streams of the generator
+#define STREAM_BLOB_CENTERS 1
+#define STREAM_BLOB_OF_VEC 2
+
+#define EVALUATE_QUALITY 1
+#define SILHOUETTE_SAMPLE 5000 // Vectors of the sampled silhouette (0: exact silhouette over all vectors)
+#define QUALITY_BLOCK 64       // Vectors per block of the silhouette distances
+
+// ***************************************************
+float Vectors[N][Nv]; // N vectors of Nv dimensions
+float Centers[Nc][Nv]; // Nc vectors of Nv dimensions
+int   Class_of_Vec[N]; // Class of each Vector
+float Distance_of_Vec[N]; // Distance of each Vector from the center of its class
+
+int Vector_Tile = 1; // Vectors classified together by classifyTile()
+const int Tile_Options[] = {1, 2, 4, 8, 16};
+const omp_sched_t Schedule_Options[] = {omp_sched_static, omp_sched_dynamic, omp_sched_guided};
+const char *Schedule_Names[] = {"", "static", "dynamic", "guided", "auto"}; // Indexed by omp_sched_t
+#if REPRODUCIBLE_REDUCTION
+const int Chunk_Options[] = {0, 1, 2, 4, 8}; // In blocks (0 is the default chunk of each schedule kind)
+#else
+const int Chunk_Options[] = {0, 16, 64, 256, 1000}; // In vectors (0 is the default chunk of each schedule kind)
+#endif
+double Block_Distances[NUM_OF_BLOCKS]; // Sum of distances of each block of vectors (reproducible reduction)
+
+float Blob_Centers[BLOBS][Nv]; // Centers of the synthetic blobs
+int   True_Class_of_Vec[N];    // Blob each Vector was drawn from
+
+
+
+// ***************************************************
+// Opens <prefix><suffix> for writing with a large stdio buffer
+// ***************************************************
+FILE *openOutputFile(const char *prefix, const char *suffix, char **buffer) {
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s%s", prefix, suffix);
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) { perror(filename); exit(1); }
+    *buffer = malloc(OUTPUT_BUFFER_SIZE);
+    if (*buffer != NULL) setvbuf(file, *buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+    return file;
+}
+
+
+// ***************************************************
+// Closes a file opened by openOutputFile()
+// ***************************************************
+void closeOutputFile(FILE *file, char *buffer) {
+    if (fclose(file) != 0) { perror("fclose"); exit(1); }
+    free(buffer);
+}
+
+
+// ***************************************************
+// Writes a 1D or 2D array in NPY format (version 1.0, little-endian <descr> such as "<f4" or "<i4")
+// ***************************************************
+void writeNPY(const char *prefix, const char *suffix, const char *descr, const void *Data, size_t elemSize, int rows, int cols) {
+    char header[128], *buffer;
+    int len;
+    if (cols > 0) len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%d, %d), }", descr, rows, cols);
+    else len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%d,), }", descr, rows);
+    int total = (10 + len + 1 + 63) / 64 * 64; // Magic (6) + version (2) + header length (2) + header + '\n', aligned to 64 bytes
+    memset(header + len, ' ', total - 10 - len - 1);
+    header[total - 10 - 1] = '\n';
+    unsigned short headerLen = total - 10;
+
+    FILE *file = openOutputFile(prefix, suffix, &buffer);
+    fwrite("\x93NUMPY\x01\x00", 1, 8, file);
+    unsigned char lenBytes[2] = { headerLen & 0xFF, headerLen >> 8 };
+    fwrite(lenBytes, 1, 2, file);
+    fwrite(header, 1, headerLen, file);
+    size_t count = (size_t) rows * (cols > 0 ? cols : 1);
+    if (fwrite(Data, elemSize, count, file) != count) { perror(suffix); exit(1); }
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes the centers as CSV (one center per line)
+// ***************************************************
+void writeCentersCSV(const char *prefix) {
+    char *buffer;
+    FILE *file = openOutputFile(prefix, "_centers.csv", &buffer);
+	for (int i = 0; i < Nc; i++)
+		for (int j = 0; j < Nv; j++)
+			fprintf(file, (j < Nv-1) ? "%f," : "%f\n", Centers[i][j]);
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes the class (and distance) of each vector as CSV
+// ***************************************************
+void writeClassesCSV(const char *prefix) {
+    char *buffer;
+    FILE *file = openOutputFile(prefix, "_classes.csv", &buffer);
+    fprintf(file, WRITE_DISTANCES ? "vector,class,distance\n" : "vector,class\n");
+	for (int i = 0; i < N; i++) {
+        if (WRITE_DISTANCES) fprintf(file, "%d,%d,%f\n", i, Class_of_Vec[i], Distance_of_Vec[i]);
+        else fprintf(file, "%d,%d\n", i, Class_of_Vec[i]);
+    }
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes all the results, files start with <prefix>
+// ***************************************************
+void writeResults(const char *prefix) {
+    writeNPY(prefix, "_centers.npy", "<f4", Centers, sizeof(float), Nc, Nv);
+    writeNPY(prefix, "_classes.npy", "<i4", Class_of_Vec, sizeof(int), N, 0);
+    if (WRITE_DISTANCES) writeNPY(prefix, "_distances.npy", "<f4", Distance_of_Vec, sizeof(float), N, 0);
+    if (DATASET == DATASET_BLOBS) writeNPY(prefix, "_truth.npy", "<i4", True_Class_of_Vec, sizeof(int), N, 0);
+    if (WRITE_CSV) {
+        writeCentersCSV(prefix);
+        writeClassesCSV(prefix);
+    }
+}
+
+
+// ****************************************************
+// Returns 1 if a Vector is not in an array of vectors
+// ****************************************************
+int notVectorInCenters(float Vec[Nv], int maxIndex) {
+
+    // Examining all the centers until <maxIndex>
+    //printf("\nChecking if vec is in centers...\n");
+    for (int c=0; c<maxIndex; c++) {
+        //printf("> Checking center %d...\n", c);
+        int flag = 1; 
+        for (int i=0; i<Nv; i++) {
+            //printf(">> Checking dim %d...\n", i);
+            
+            if (Vec[i] != Centers[c][i]) {
+                //printf(">>> This dimension is different, so no need to keep checking this center.\n");
+                flag = 0;
+                break;
+            }
+        }
+        if (flag)     // If <flag> remains equal to 1, then the vector <Vec> is equal to current examined center <c>
+            return 0; // So <Vec> is unsuitable to become a new Center
+
+    }
+
+    return 1;
+}
+
+
+// ****************************************************
+// Picks a new center when the last one has no neighbours
+// ****************************************************
+void pickSubstituteCenter(int indexOfCenterToChange){
+    int currentVec = 0;
+
+    // Searching for a vector that is not a center, so as to mark it as one
+    printf("> Now searching for a substitute center...\n");
+    do {
+        printf(">> Now examining vec:%d\n", currentVec);
+        if (notVectorInCenters(Vectors[currentVec], Nc)) {
+            printf(">>> Current vec is not in existing centers\n");
+            for (int i=0; i<Nv; i++) 
+                Centers[indexOfCenterToChange][i] = Vectors[currentVec][i];  
+                
+            printf(">>> Substituted old center with current vector\n");
+            return;    // If a substitute center is found, stop this function             
+        }
+            
+        printf(">>> WARNING: If the center was substituted, this line must not be present\n");
+        currentVec ++; // else contunue searching
+    } while (currentVec<N);
+
+    printf("\n");
+    return;
+}
+
+
+// ****************************************************
+// Chooses the first unique Nc vectors as class centers
+// ****************************************************
+void initCenters2() {
+    int currentCenter=0, currentVec=0;
+    do {
+        if (notVectorInCenters(Vectors[currentVec], currentCenter)) {
+            for (int i=0; i<Nv; i++) 
+                Centers[currentCenter][i] = Vectors[currentVec][i];
+            currentCenter ++;                
+            }
+        currentVec++;
+    } while (currentCenter<Nc);
+}
+
+
+// *************************************************************************
+// Returns the squared Euclidean distance between two vectors
+// *************************************************************************
+static inline float squaredDistance(const float A[Nv], const float B[Nv]) {
+    float dist = 0;
+
+    #pragma omp simd reduction(+:dist) // If <reduction> is omitted, the compiler protects from math error and does not perform SIMD 
+    for (int j=0; j<Nv; j++) 
+        dist += (A[j]-B[j]) * (A[j]-B[j]);
+    return dist;
+}
+
+
+// *************************************************************************
+// Updates the classes of the <count> vectors starting from <first> and their distances from the closest center
+// *************************************************************************
+static inline void classifyTile(int first, int count) {
+    float min_dist[MAX_TILE];
+	int temp_class[MAX_TILE];
+    for (int t=0; t<count; t++) { min_dist[t] = 1e30; temp_class[t] = -1; }
+
+    for (int i=0; i<Nc; i++) {
+        for (int t=0; t<count; t++) { // Center i stays in cache for all the vectors of the tile
+            float dist = squaredDistance(Vectors[first+t], Centers[i]); // Distance between Vec and Center i
+
+            if (dist < min_dist[t]) {
+                temp_class[t] = i;
+                min_dist[t] = dist;
+            }
+        }
+    }
+    for (int t=0; t<count; t++) {
+        Class_of_Vec[first+t] = temp_class[t]; // Update the current vector's class with the new one
+        Distance_of_Vec[first+t] = sqrt(min_dist[t]);
+    }
+}
+
+
+// *************************************************************************
+// Adds <count> values with pairwise summation (the order of additions depends only on <count>)
+// *************************************************************************
+double pairwiseSum(const double *Values, int count) {
+    if (count <= 8) {
+        double sum = 0;
+        for (int i=0; i<count; i++) sum += Values[i];
+        return sum;
+    }
+    int half = count/2;
+    return pairwiseSum(Values, half) + pairwiseSum(Values+half, count-half);
+}
+
+
+// *************************************************************************
+// Returns the sum of distances between the first <count> vectors and their closest center
+// *************************************************************************
+float estimateClasses(int count) {
+#if REPRODUCIBLE_REDUCTION
+    // Each block is summed by a single thread in a fixed order, whichever thread that is
+    int blocks = (count+REDUCTION_BLOCK-1)/REDUCTION_BLOCK;
+    #pragma omp parallel for schedule(runtime)
+    for (int b=0; b<blocks; b++) {
+        int last = (b+1)*REDUCTION_BLOCK < count ? (b+1)*REDUCTION_BLOCK : count;
+        double block_distances = 0;
+        for (int w=b*REDUCTION_BLOCK; w<last; w+=Vector_Tile)
+            classifyTile(w, (w+Vector_Tile < last) ? Vector_Tile : last-w);
+        for (int w=b*REDUCTION_BLOCK; w<last; w++)
+            block_distances += Distance_of_Vec[w];
+        Block_Distances[b] = block_distances;
+    }
+    return pairwiseSum(Block_Distances, blocks);
+#else
+    float tot_min_distances = 0;
+	
+    #pragma omp parallel for reduction(+:tot_min_distances) schedule(runtime)
+    for (int w=0; w<count; w+=Vector_Tile) {
+        int tile = (w+Vector_Tile < count) ? Vector_Tile : count-w;
+        classifyTile(w, tile);
+        for (int t=0; t<tile; t++)
+            tot_min_distances += Distance_of_Vec[w+t]; // Increase the sum of distances
+    }
+    return tot_min_distances;
+#endif
+}
+
+
+// ***************************************************
+// Find the new centers
+// ***************************************************
+void estimateCenters() {
+    int Centers_matchings[Nc] = {0};    
+
+    // Zero all center vectors
+	for (int i = 0; i < Nc; i++)
+		for (int j = 0; j < Nv; j++)
+			Centers[i][j] = 0;
+	
+    // Add each vector's values to its corresponding center
+    for (int w = 0; w < N; w ++) {
+        Centers_matchings[Class_of_Vec[w]] ++;
+        for (int j = 0; j<Nv; j++)
+            Centers[Class_of_Vec[w]][j] += Vectors[w][j];
+    }
+
+	for (int i = 0; i < Nc; i++)
+		if (Centers_matchings[i] != 0)
+			for (int j = 0; j < Nv; j++)
+				Centers[i][j] /= Centers_matchings[i];
+
+    // Empty centers are substituted once all the other centers are known. The classes are not changed here,
+    // so recalculating the centers (as the previous versions did) would find the same empty centers forever
+	for (int i = 0; i < Nc; i++)
+		if (Centers_matchings[i] == 0) {
+			printf("\nWARNING: Center %d has no members.\n", i);
+            pickSubstituteCenter(i);
+        }
+}
+
+
+// ***************************************************
+// Philox4x32-10 on <PHILOX_LANES> consecutive counters (<a>, <first_b>+lane, <stream>, 0).
+// Word k of the result of each lane is stored in Out[k][lane]; the loops over the lanes are vectorized
+// ***************************************************
+static inline void philoxLanes(uint32_t a, uint32_t first_b, uint32_t stream, uint32_t Out[4][PHILOX_LANES]) {
+    uint32_t key0 = (uint32_t) DATA_SEED, key1 = (uint32_t)((uint64_t) DATA_SEED >> 32);
+
+    #pragma omp simd
+    for (int l=0; l<PHILOX_LANES; l++) {
+        Out[0][l] = a; Out[1][l] = first_b + l; Out[2][l] = stream; Out[3][l] = 0;
+    }
+    for (int round=0; round<10; round++) {
+        #pragma omp simd
+        for (int l=0; l<PHILOX_LANES; l++) {
+            uint64_t product0 = (uint64_t) PHILOX_M0 * Out[0][l];
+            uint64_t product1 = (uint64_t) PHILOX_M1 * Out[2][l];
+            uint32_t c0 = (uint32_t)(product1 >> 32) ^ Out[1][l] ^ key0;
+            uint32_t c2 = (uint32_t)(product0 >> 32) ^ Out[3][l] ^ key1;
+            Out[0][l] = c0; Out[1][l] = (uint32_t) product1; Out[2][l] = c2; Out[3][l] = (uint32_t) product0;
+        }
+        key0 += PHILOX_W0; key1 += PHILOX_W1;
+    }
+}
+
+
+// ***************************************************
+// Converts a random 32-bit value to a float in [0,1) (or in (0,1] when <open_zero> is 1)
+// ***************************************************
+static inline float uniformFloat(uint32_t x, int open_zero) {
+    return ((x >> 8) + open_zero) * (1.0f/16777216.0f);
+}
+
+
+// ***************************************************
+// Fills <Out> with <count> uniform values in [0,1): element e of row <row> comes from counter (<row>, e/4, <stream>)
+// ***************************************************
+void generateUniform(uint32_t row, uint32_t stream, float *Out, int count) {
+    uint32_t Random[4][PHILOX_LANES];
+    for (int e0 = 0; e0 < count; e0 += 4*PHILOX_LANES) {
+        philoxLanes(row, e0/4, stream, Random);
+        if (e0 + 4*PHILOX_LANES <= count) {
+            #pragma omp simd
+            for (int l=0; l<PHILOX_LANES; l++)
+                for (int k=0; k<4; k++) Out[e0 + 4*l + k] = uniformFloat(Random[k][l], 0);
+        } else {
+            for (int e = e0; e < count; e++) Out[e] = uniformFloat(Random[(e-e0)%4][(e-e0)/4], 0);
+        }
+    }
+}
+
+
+// ***************************************************
+// Fills <Out> with <count> standard normal values (Box-Muller on the same counters as generateUniform())
+// ***************************************************
+void generateNormal(uint32_t row, uint32_t stream, float *Out, int count) {
+    uint32_t Random[4][PHILOX_LANES];
+    float Normal[4][PHILOX_LANES];
+    for (int e0 = 0; e0 < count; e0 += 4*PHILOX_LANES) {
+        philoxLanes(row, e0/4, stream, Random);
+        #pragma omp simd
+        for (int l=0; l<PHILOX_LANES; l++)
+            for (int k=0; k<4; k+=2) {
+                float radius = sqrtf(-2.0f * logf(uniformFloat(Random[k][l], 1)));
+                float angle = 6.2831853f * uniformFloat(Random[k+1][l], 0);
+                Normal[k][l] = radius * cosf(angle);
+                Normal[k+1][l] = radius * sinf(angle);
+            }
+        int last = (e0 + 4*PHILOX_LANES < count) ? e0 + 4*PHILOX_LANES : count;
+        for (int e = e0; e < last; e++) Out[e] = Normal[(e-e0)%4][(e-e0)/4];
+    }
+}
+
+
+// ***************************************************
+// Initializing the vectors with random values (every element is computed independently)
+// ***************************************************
+void SetVec( void ) {
+    if (DATASET == DATASET_BLOBS) {
+        // Blob centers and the blob of each vector come from their own streams
+        for (int b = 0; b < BLOBS; b++)
+            generateUniform(b, STREAM_BLOB_CENTERS, Blob_Centers[b], Nv);
+
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < N; i++) {
+            uint32_t Random[4][PHILOX_LANES];
+            philoxLanes(i, 0, STREAM_BLOB_OF_VEC, Random);
+            True_Class_of_Vec[i] = (int)(((uint64_t) Random[0][0] * BLOBS) >> 32); // Multiply-shift instead of %
+        }
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < N; i++) {
+        if (DATASET == DATASET_BLOBS) {
+            generateNormal(i, STREAM_VECTORS, Vectors[i], Nv);
+            #pragma omp simd
+            for (int j = 0; j < Nv; j++)
+                Vectors[i][j] = Blob_Centers[True_Class_of_Vec[i]][j] + BLOB_STDDEV * Vectors[i][j];
+        } else
+            generateUniform(i, STREAM_VECTORS, Vectors[i], Nv);
+    }
+}
+
+
+// ***************************************************
+// Compares the classes with the ground truth of the blobs (purity and total distance from the true blob centers)
+// ***************************************************
+void evaluateGroundTruth(float totDist) {
+    static int Contingency[Nc][BLOBS];
+    int purity = 0;
+    double trueDist = 0;
+
+    memset(Contingency, 0, sizeof(Contingency));
+    for (int w = 0; w < N; w++) Contingency[Class_of_Vec[w]][True_Class_of_Vec[w]] ++;
+    for (int i = 0; i < Nc; i++) {
+        int most = 0;
+        for (int b = 0; b < BLOBS; b++) if (Contingency[i][b] > most) most = Contingency[i][b];
+        purity += most; // Vectors of class i that belong to its most common blob
+    }
+
+    #pragma omp parallel for reduction(+:trueDist) schedule(static)
+    for (int w = 0; w < N; w++) {
+        trueDist += sqrt(squaredDistance(Vectors[w], Blob_Centers[True_Class_of_Vec[w]]));
+    }
+
+    printf("Ground truth: purity %.4f, total distance from the true blob centers %.6f (found %.6f)\n",
+        (float) purity / N, trueDist, totDist);
+}
+
+
+// ***************************************************
+// Computes the mean of the vectors of each class in <Means> and the number of vectors of each class in <Sizes>
+// ***************************************************
+void classMeans(float Means[Nc][Nv], int Sizes[Nc]) {
+    int threads = omp_get_max_threads();
+    double *Thread_Sums = calloc((size_t)threads * Nc * Nv, sizeof(double)); // [threads][Nc][Nv]
+    memset(Sizes, 0, sizeof(int)*Nc);
+
+    // Each thread adds a contiguous block of vectors (read row by row) to its own sums
+    #pragma omp parallel num_threads(threads) reduction(+:Sizes[:Nc])
+    {
+        double (*Sums)[Nv] = (double (*)[Nv]) &Thread_Sums[(size_t)omp_get_thread_num() * Nc * Nv];
+        #pragma omp for schedule(static)
+        for (int w = 0; w < N; w++) {
+            Sizes[Class_of_Vec[w]] ++;
+            #pragma omp simd
+            for (int j = 0; j < Nv; j++)
+                Sums[Class_of_Vec[w]][j] += Vectors[w][j];
+        }
+    }
+
+    // The sums of the threads are combined per class
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < Nc; i++)
+        for (int j = 0; j < Nv; j++) {
+            double sum = 0;
+            for (int t = 0; t < threads; t++) sum += Thread_Sums[((size_t)t*Nc + i)*Nv + j];
+            Means[i][j] = (Sizes[i] > 0) ? sum / Sizes[i] : 0;
+        }
+    free(Thread_Sums);
+}
+
+
+// ***************************************************
+// Computes the Davies-Bouldin and the Calinski-Harabasz indices of the current classes
+// ***************************************************
+void clusterIndices(double *DaviesBouldin, double *CalinskiHarabasz) {
+    static float Means[Nc][Nv];
+    int Sizes[Nc], clusters = 0;
+    double Scatter[Nc] = {0}, withinSS = 0, betweenSS = 0;
+    float Overall[Nv];
+
+    classMeans(Means, Sizes);
+
+    // Mean distance (Davies-Bouldin) and sum of squared distances (Calinski-Harabasz) of the vectors from the mean of their class
+    #pragma omp parallel for reduction(+:withinSS, Scatter[:Nc]) schedule(static)
+    for (int w = 0; w < N; w++) {
+        float dist = squaredDistance(Vectors[w], Means[Class_of_Vec[w]]);
+        withinSS += dist;
+        Scatter[Class_of_Vec[w]] += sqrt(dist);
+    }
+
+    for (int j = 0; j < Nv; j++) {
+        double sum = 0;
+        for (int i = 0; i < Nc; i++) sum += (double) Sizes[i] * Means[i][j];
+        Overall[j] = sum / N;
+    }
+    for (int i = 0; i < Nc; i++) {
+        if (Sizes[i] == 0) continue;
+        clusters ++;
+        Scatter[i] /= Sizes[i];
+        betweenSS += Sizes[i] * (double) squaredDistance(Means[i], Overall);
+    }
+
+    *DaviesBouldin = 0;
+    for (int i = 0; i < Nc; i++) {
+        if (Sizes[i] == 0) continue;
+        double worst = 0;
+        for (int k = 0; k < Nc; k++) {
+            if (k == i || Sizes[k] == 0) continue;
+            double separation = sqrt(squaredDistance(Means[i], Means[k]));
+            if (separation == 0) continue; // Coincident means (identical classes) have no defined ratio
+            double ratio = (Scatter[i] + Scatter[k]) / separation;
+            if (ratio > worst) worst = ratio;
+        }
+        *DaviesBouldin += worst;
+    }
+    *DaviesBouldin /= clusters;
+    *CalinskiHarabasz = (clusters > 1 && withinSS > 0) ? (betweenSS / (clusters-1)) / (withinSS / (N-clusters)) : 0;
+}
+
+
+// ***************************************************
+// Returns the mean silhouette coefficient of the <count> vectors of <Index>, using only these vectors as references
+// ***************************************************
+double silhouette(const int *Index, int count) {
+    int Sizes[Nc] = {0}, blocks = (count+QUALITY_BLOCK-1)/QUALITY_BLOCK;
+    double total = 0;
+    double (*Sums)[Nc] = calloc((size_t)count, sizeof(double) * Nc); // Sum of distances of each vector from each class
+    for (int k = 0; k < count; k++) Sizes[Class_of_Vec[Index[k]]] ++;
+
+    // Each pair of vectors is computed once (blocks jb >= ib) and added to the sums of both vectors. The sums of a block are
+    // collected locally and added to <Sums> under the lock of the block, since other threads add to the same vectors
+    omp_lock_t *Locks = malloc(sizeof(omp_lock_t) * blocks);
+    for (int k = 0; k < blocks; k++) omp_init_lock(&Locks[k]);
+    #pragma omp parallel
+    {
+        double (*RowSums)[Nc] = calloc(QUALITY_BLOCK, sizeof(double) * Nc); // Sums of the vectors of block ib
+        double (*ColSums)[Nc] = calloc(QUALITY_BLOCK, sizeof(double) * Nc); // Sums of the vectors of block jb
+
+        #pragma omp for schedule(dynamic)
+        for (int ib = 0; ib < blocks; ib++) {
+            int iFirst = ib*QUALITY_BLOCK, iLast = (iFirst+QUALITY_BLOCK < count) ? iFirst+QUALITY_BLOCK : count;
+            for (int jb = ib; jb < blocks; jb++) {
+                int jFirst = jb*QUALITY_BLOCK, jLast = (jFirst+QUALITY_BLOCK < count) ? jFirst+QUALITY_BLOCK : count;
+                for (int i = iFirst; i < iLast; i++)
+                    for (int j = (jb == ib) ? i+1 : jFirst; j < jLast; j++) {
+                        double dist = sqrt(squaredDistance(Vectors[Index[i]], Vectors[Index[j]]));
+                        RowSums[i-iFirst][Class_of_Vec[Index[j]]] += dist;
+                        if (jb == ib) RowSums[j-iFirst][Class_of_Vec[Index[i]]] += dist;
+                        else ColSums[j-jFirst][Class_of_Vec[Index[i]]] += dist;
+                    }
+                if (jb == ib) continue;
+                omp_set_lock(&Locks[jb]);
+                for (int j = jFirst; j < jLast; j++)
+                    for (int c = 0; c < Nc; c++) { Sums[j][c] += ColSums[j-jFirst][c]; ColSums[j-jFirst][c] = 0; } // Cleared for the next block
+                omp_unset_lock(&Locks[jb]);
+            }
+            omp_set_lock(&Locks[ib]);
+            for (int i = iFirst; i < iLast; i++)
+                for (int c = 0; c < Nc; c++) { Sums[i][c] += RowSums[i-iFirst][c]; RowSums[i-iFirst][c] = 0; }
+            omp_unset_lock(&Locks[ib]);
+        }
+        free(RowSums); free(ColSums);
+    }
+    for (int k = 0; k < blocks; k++) omp_destroy_lock(&Locks[k]);
+    free(Locks);
+
+    #pragma omp parallel for reduction(+:total) schedule(static)
+    for (int i = 0; i < count; i++) {
+        int own = Class_of_Vec[Index[i]];
+        if (Sizes[own] < 2) continue; // The silhouette of a single-member class is 0
+        double a = Sums[i][own] / (Sizes[own]-1), b = INFINITY;
+        for (int c = 0; c < Nc; c++)
+            if (c != own && Sizes[c] > 0 && Sums[i][c] / Sizes[c] < b) b = Sums[i][c] / Sizes[c];
+        if (b < INFINITY) total += (b - a) / ((a > b) ? a : b);
+    }
+    free(Sums);
+    return total / count;
+}
+
+
+// ***************************************************
+// Prints the quality indices of the final classes
+// ***************************************************
+void evaluateQuality() {
+    double daviesBouldin, calinskiHarabasz, start = omp_get_wtime();
+    clusterIndices(&daviesBouldin, &calinskiHarabasz);
+    printf("Davies-Bouldin index: %.6lf   Calinski-Harabasz index: %.6lf   (%.3lf seconds)\n",
+        daviesBouldin, calinskiHarabasz, omp_get_wtime() - start);
+
+    int count = (SILHOUETTE_SAMPLE > 0 && SILHOUETTE_SAMPLE < N) ? SILHOUETTE_SAMPLE : N;
+    int *Index = malloc(sizeof(int) * count);
+    for (int k = 0; k < count; k++) Index[k] = (int)((long) k * N / count); // Fixed stride over the data
+
+    start = omp_get_wtime();
+    double score = silhouette(Index, count);
+    printf("Silhouette coefficient: %.6lf   (%s over %d vectors, %.3lf seconds)\n",
+        score, (count < N) ? "sampled" : "exact", count, omp_get_wtime() - start);
+    free(Index);
+}
+
+
+// ***************************************************
+// Returns the CPU model name (from /proc/cpuinfo) in <Model>
+// ***************************************************
+void getCpuModel(char *Model, int size) {
+    char line[512];
+    snprintf(Model, size, "unknown-cpu");
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (file == NULL) return;
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "model name", 10) == 0 && strchr(line, ':')) {
+            char *name = strchr(line, ':') + 1;
+            while (*name == ' ') name++;
+            name[strcspn(name, "\t\n")] = '\0';
+            snprintf(Model, size, "%s", name);
+            break;
+        }
+    }
+    fclose(file);
+}
+
+
+// ***************************************************
+// Writes the key of the current program, CPU and problem shape to <Key>
+// ***************************************************
+void getTuningKey(char *Key, int size) {
+    char model[256];
+    getCpuModel(model, sizeof(model));
+    snprintf(Key, size, "%s\t%s\t%d\t%d\t%d\t%s", TUNING_PROGRAM, model, N, Nv, Nc, REPRODUCIBLE_REDUCTION ? "reproducible" : "fast");
+}
+
+
+// ***************************************************
+// Applies a configuration to the OpenMP runtime and the classification kernel
+// ***************************************************
+void applyConfiguration(int threads, omp_sched_t kind, int chunk, int tile) {
+    omp_set_num_threads(threads);
+    omp_set_schedule(kind, chunk);
+    Vector_Tile = tile;
+}
+
+
+// ***************************************************
+// Looks up the current key in <TUNING_FILE> and applies its configuration. Returns 1 if it was found
+// ***************************************************
+int loadTuning() {
+    char key[512], line[1024];
+    getTuningKey(key, sizeof(key));
+    FILE *file = fopen(TUNING_FILE, "r");
+    if (file == NULL) return 0;
+
+    int found = 0;
+    size_t keyLen = strlen(key);
+    while (!found && fgets(line, sizeof(line), file)) {
+        int threads, kind, chunk, tile;
+        if (strncmp(line, key, keyLen) != 0 || line[keyLen] != '\t') continue;
+        if (sscanf(line + keyLen + 1, "%d\t%d\t%d\t%d", &threads, &kind, &chunk, &tile) != 4) continue;
+        if (threads < 1 || kind < 1 || kind > 4 || tile < 1 || tile > MAX_TILE) continue;
+        applyConfiguration(threads, (omp_sched_t) kind, chunk, tile);
+        printf("Loaded tuned configuration from %s: threads=%d schedule=%s chunk=%d tile=%d\n",
+            TUNING_FILE, threads, Schedule_Names[kind], chunk, tile);
+        found = 1;
+    }
+    fclose(file);
+    return found;
+}
+
+
+// ***************************************************
+// Replaces (or adds) the entry of the current key in <TUNING_FILE>
+// ***************************************************
+void saveTuning(int threads, omp_sched_t kind, int chunk, int tile, double seconds) {
+    char key[512], line[1024];
+    getTuningKey(key, sizeof(key));
+    size_t keyLen = strlen(key), kept = 0, capacity = 4096;
+    char *others = malloc(capacity);
+    if (others == NULL) { printf("WARNING: Not enough memory to save the tuned configuration\n"); return; }
+    others[0] = '\0';
+
+    // Keep the entries of other keys
+    FILE *file = fopen(TUNING_FILE, "r");
+    if (file != NULL) {
+        while (fgets(line, sizeof(line), file)) {
+            if (strncmp(line, key, keyLen) == 0 && line[keyLen] == '\t') continue;
+            size_t len = strlen(line);
+            if (kept + len + 1 > capacity) {
+                char *larger = realloc(others, 2*(kept + len + 1));
+                if (larger == NULL) { printf("WARNING: Not enough memory to save the tuned configuration\n"); fclose(file); free(others); return; }
+                others = larger; capacity = 2*(kept + len + 1);
+            }
+            memcpy(others + kept, line, len + 1);
+            kept += len;
+        }
+        fclose(file);
+    }
+
+    file = fopen(TUNING_FILE, "w");
+    if (file == NULL) { perror(TUNING_FILE); free(others); return; }
+    fputs(others, file);
+    fprintf(file, "%s\t%d\t%d\t%d\t%d\t%.6lf\n", key, threads, (int) kind, chunk, tile, seconds);
+    fclose(file);
+    free(others);
+    printf("Tuned configuration saved to %s\n", TUNING_FILE);
+}
+
+
+// ***************************************************
+// Returns the fastest of <AUTOTUNE_RUNS> runs of estimateClasses() on the sample with the given configuration
+// ***************************************************
+double timeConfiguration(int threads, omp_sched_t kind, int chunk, int tile) {
+    double best = INFINITY;
+    int sample = (AUTOTUNE_SAMPLE < N) ? AUTOTUNE_SAMPLE : N;
+    applyConfiguration(threads, kind, chunk, tile);
+    for (int r=0; r<AUTOTUNE_RUNS; r++) {
+        double start = omp_get_wtime();
+        estimateClasses(sample);
+        double seconds = omp_get_wtime() - start;
+        if (seconds < best) best = seconds;
+    }
+    printf(">> threads=%2d schedule=%-7s chunk=%4d tile=%2d  ===> %.4lf s\n", threads, Schedule_Names[kind], chunk, tile, best);
+    return best;
+}
+
+
+// ***************************************************
+// Sweeps thread counts, schedule kinds, chunk sizes and tile sizes on a sample of the vectors (the centers must be initialized)
+// ***************************************************
+void autotune() {
+    int bestThreads = omp_get_max_threads(), bestChunk = 0, bestTile = 1;
+    omp_sched_t bestKind = omp_sched_static;
+    double bestSeconds = INFINITY, seconds;
+
+    printf("Now autotuning on %d vectors...\n", (AUTOTUNE_SAMPLE < N) ? AUTOTUNE_SAMPLE : N);
+    printf("> Thread counts:\n");
+    for (int threads = omp_get_max_threads(); threads >= 1; threads /= 2)
+        if ((seconds = timeConfiguration(threads, bestKind, bestChunk, bestTile)) < bestSeconds) { bestSeconds = seconds; bestThreads = threads; }
+
+    printf("> Schedule kinds and chunk sizes:\n");
+    for (size_t k = 0; k < sizeof(Schedule_Options)/sizeof(Schedule_Options[0]); k++)
+        for (size_t c = 0; c < sizeof(Chunk_Options)/sizeof(Chunk_Options[0]); c++)
+            if ((seconds = timeConfiguration(bestThreads, Schedule_Options[k], Chunk_Options[c], bestTile)) < bestSeconds) {
+                bestSeconds = seconds; bestKind = Schedule_Options[k]; bestChunk = Chunk_Options[c];
+            }
+
+    printf("> Tile sizes:\n");
+    for (size_t t = 0; t < sizeof(Tile_Options)/sizeof(Tile_Options[0]); t++)
+        if ((seconds = timeConfiguration(bestThreads, bestKind, bestChunk, Tile_Options[t])) < bestSeconds) { bestSeconds = seconds; bestTile = Tile_Options[t]; }
+
+    printf("Best configuration: threads=%d schedule=%s chunk=%d tile=%d (%.4lf s per sample)\n",
+        bestThreads, Schedule_Names[bestKind], bestChunk, bestTile, bestSeconds);
+    applyConfiguration(bestThreads, bestKind, bestChunk, bestTile);
+    saveTuning(bestThreads, bestKind, bestChunk, bestTile, bestSeconds);
+}
+
+
+// ***************************************************
+// The main program
+// ***************************************************
+int main( int argc, const char* argv[] ) {
+    int repetitions = 0;
+    float totDist, prevDist, diff;
+    const char *outputPrefix = DEFAULT_OUTPUT_PREFIX;
+    int forceAutotune = 0;
+    for (int a=1; a<argc; a++) {
+        if (strcmp(argv[a], "--autotune") == 0) forceAutotune = 1;
+        else outputPrefix = argv[a];
+    }
+	printf("--------------------------------------------------------------------------------------------------\n");
+	printf("This program executes the K-Means algorithm for random vectors of arbitrary number and dimensions.\n");
+	printf("Current configuration has %d Vectors, %d Classes and %d Elements per vector.\n", N, Nc, Nv);
+	printf("--------------------------------------------------------------------------------------------------\n");
+    printf("Now initializing vectors (%s)...\n", (DATASET == DATASET_BLOBS) ? "Gaussian blobs" : "uniform");
+    double setStart = omp_get_wtime();
+    SetVec() ;
+    printf("Vectors initialized in %.3lf seconds\n", omp_get_wtime() - setStart);
+    
+    printf("Now initializing centers...\n");
+    initCenters2() ;
+
+    omp_set_schedule(omp_sched_static, 0); // Same as schedule(static) of the previous versions
+    if (forceAutotune || !loadTuning()) autotune();
+
+	totDist = 1.0e30;
+    printf("\nNow running the main algorithm (%s reduction, %d threads)...\n\n", REPRODUCIBLE_REDUCTION ? "reproducible" : "fast", omp_get_max_threads());
+    double start = omp_get_wtime();
+    do {
+        repetitions++; 
+        prevDist = totDist ;
+        
+        totDist = estimateClasses(N) ;
+        estimateCenters() ;
+        diff = (prevDist-totDist)/totDist ;
+
+        printf(">> REPETITION: %3d  ||  ", repetitions);
+        printf("DISTANCE IMPROVEMENT: %.6f \n", diff);
+    } while( (diff > THRESHOLD) && (repetitions < MAX_REPETITIONS) ) ;
+    totDist = estimateClasses(N) ; // Classes and distances of the final centers, the ones that are written
+
+    double elapsed = omp_get_wtime() - start;
+
+    printf("\n\nProcess finished!\n");
+	printf("Total repetitions were: %d\n", repetitions);
+	printf("Total distance is: %.6f\n", totDist);
+	printf("Main algorithm time: %.3lf seconds\n", elapsed);
+    if (DATASET == DATASET_BLOBS) evaluateGroundTruth(totDist);
+    if (EVALUATE_QUALITY) evaluateQuality();
+
+    printf("Now writing the results to %s_*...\n", outputPrefix);
+    start = omp_get_wtime();
+    writeResults(outputPrefix) ;
+	printf("Results written in %.3lf seconds\n", omp_get_wtime() - start);
+    return 0 ;
+}
+
+//**********************************************************************************************************
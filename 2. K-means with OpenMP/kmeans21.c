@@ -0,0 +1,383 @@
+/*
+Description:
+    This program executes the online (sequential, MacQueen) K-Means algorithm for a stream of vectors
+    of arbitrary dimensions that is read from the standard input or a FIFO
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+
+Version Notes:
+    Compiles with: gcc kmeans21.c -o kmeans21 -lm -fopt-info -fopenmp -O3
+    Runs with: producer | ./kmeans21 [- | input_file_or_fifo] [output_prefix]
+               e.g. ./kmeans21 < kmeans14_vectors.bin   or   mkfifo vecs && ./kmeans21 vecs & producer > vecs
+    Uses the assignment kernel of kmeans20 (squaredDistance(), classifyTile()) unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> The input is a stream of float32 vectors (Nv values each, no header), of unknown length; it is read in batches of
+        up to <BATCH_SIZE> vectors with poll() and read(): the program waits until data arrive and then takes everything that is
+        already available, so a batch is processed as soon as at least one whole vector has arrived (partial batches on a slow pipe).
+        A partial vector is kept for the next batch; a partial vector at the end of the stream is reported and dropped
+    --> The first Nc unique vectors of the stream become the initial centers
+    --> The vectors of each batch are classified in parallel with the centers of the previous batch
+    --> The centers are then updated incrementally in arrival order (MacQueen): center += (vector - center) / members.
+        The member count each vector sees is found serially, so the update itself runs in parallel over the dimensions
+        and gives the same centers as a serial update
+    --> The latency of each batch is recorded from the read of its first data to the end of the update (reading the rest of the batch,
+        classification and update); the time spent waiting for the producer before any data arrive is not included.
+        The 50th/90th/99th percentiles and the maximum of the last <REPORT_INTERVAL> batches are printed periodically, and of all
+        batches at the end
+    --> Every <SNAPSHOT_INTERVAL> batches (and at the end) the centers and their member counts are written to <prefix>_centers.npy and
+        <prefix>_counts.npy. Each file is written under a temporary name and then renamed, so readers never see a partial snapshot
+
+*/
+
+// *******************************************************************
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline", "unsafe-math-optimizations") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// *******************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <omp.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// ***************************************************
+#define Nv 1000
+#define Nc 100
+
+#define BATCH_SIZE 1024       // Maximum vectors per batch
+#define MAX_TILE 16
+#define VECTOR_TILE 4         // Vectors classified together by classifyTile()
+#define REPORT_INTERVAL 100   // Batches between latency reports
+#define SNAPSHOT_INTERVAL 100 // Batches between snapshots of the centers
+#define OUTPUT_BUFFER_SIZE (8*1024*1024)
+#define DEFAULT_OUTPUT_PREFIX "kmeans21"
+
+// ***************************************************
+float Batch[BATCH_SIZE][Nv];  // Vectors of the current batch
+int   Class_of_Vec[BATCH_SIZE]; // Class of each vector of the batch
+int   Members_of_Vec[BATCH_SIZE]; // Members of its class after each vector of the batch was added
+float Centers[Nc][Nv];        // Nc vectors of Nv dimensions
+int   Centers_matchings[Nc];  // Vectors that have been added to each center so far
+
+size_t BatchBytes;            // Bytes read into <Batch>, including a partial vector after the last whole one
+int    BatchCount;            // Whole vectors of the last batch returned by readBatch()
+int    EndOfStream;
+double BatchArrival;          // Time the first bytes of the current batch were read
+
+double *Latencies;            // Latency of each batch (seconds)
+long   NumOfBatches, LatencyCapacity;
+
+
+
+// ***************************************************
+// Opens <prefix><suffix> for writing with a large stdio buffer
+// ***************************************************
+FILE *openOutputFile(const char *prefix, const char *suffix, char **buffer) {
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s%s", prefix, suffix);
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) { perror(filename); exit(1); }
+    *buffer = malloc(OUTPUT_BUFFER_SIZE);
+    if (*buffer != NULL) setvbuf(file, *buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+    return file;
+}
+
+
+// ***************************************************
+// Closes a file opened by openOutputFile()
+// ***************************************************
+void closeOutputFile(FILE *file, char *buffer) {
+    if (fclose(file) != 0) { perror("fclose"); exit(1); }
+    free(buffer);
+}
+
+
+// ***************************************************
+// Writes a 1D or 2D array in NPY format (version 1.0, little-endian <descr> such as "<f4" or "<i4")
+// ***************************************************
+void writeNPY(const char *prefix, const char *suffix, const char *descr, const void *Data, size_t elemSize, int rows, int cols) {
+    char header[128], *buffer;
+    int len;
+    if (cols > 0) len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%d, %d), }", descr, rows, cols);
+    else len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%d,), }", descr, rows);
+    int total = (10 + len + 1 + 63) / 64 * 64; // Magic (6) + version (2) + header length (2) + header + '\n', aligned to 64 bytes
+    memset(header + len, ' ', total - 10 - len - 1);
+    header[total - 10 - 1] = '\n';
+    unsigned short headerLen = total - 10;
+
+    FILE *file = openOutputFile(prefix, suffix, &buffer);
+    fwrite("\x93NUMPY\x01\x00", 1, 8, file);
+    unsigned char lenBytes[2] = { headerLen & 0xFF, headerLen >> 8 };
+    fwrite(lenBytes, 1, 2, file);
+    fwrite(header, 1, headerLen, file);
+    size_t count = (size_t) rows * (cols > 0 ? cols : 1);
+    if (fwrite(Data, elemSize, count, file) != count) { perror(suffix); exit(1); }
+    closeOutputFile(file, buffer);
+}
+
+
+// ***************************************************
+// Writes the current centers and their member counts (through temporary files that are then renamed)
+// ***************************************************
+void snapshotCenters(const char *prefix) {
+    char temporary[1024], final[1024];
+    writeNPY(prefix, "_centers.npy.tmp", "<f4", Centers, sizeof(float), Nc, Nv);
+    writeNPY(prefix, "_counts.npy.tmp", "<i4", Centers_matchings, sizeof(int), Nc, 0);
+
+    snprintf(temporary, sizeof(temporary), "%s_centers.npy.tmp", prefix);
+    snprintf(final, sizeof(final), "%s_centers.npy", prefix);
+    if (rename(temporary, final) != 0) perror(final);
+    snprintf(temporary, sizeof(temporary), "%s_counts.npy.tmp", prefix);
+    snprintf(final, sizeof(final), "%s_counts.npy", prefix);
+    if (rename(temporary, final) != 0) perror(final);
+}
+
+
+// ****************************************************
+// Returns 1 if a Vector is not in an array of vectors
+// ****************************************************
+int notVectorInCenters(const float Vec[Nv], int maxIndex) {
+
+    // Examining all the centers until <maxIndex>
+    for (int c=0; c<maxIndex; c++) {
+        int flag = 1;
+        for (int i=0; i<Nv; i++) {
+            if (Vec[i] != Centers[c][i]) {
+                flag = 0;
+                break;
+            }
+        }
+        if (flag)     // If <flag> remains equal to 1, then the vector <Vec> is equal to current examined center <c>
+            return 0; // So <Vec> is unsuitable to become a new Center
+    }
+
+    return 1;
+}
+
+
+// ***************************************************
+// Reads the next batch from <fd>: waits until at least one whole vector has arrived, then takes everything that is already
+// available (up to <BATCH_SIZE> vectors). Returns the number of whole vectors read (0 at the end of the stream)
+// ***************************************************
+int readBatch(int fd) {
+    size_t vectorBytes = sizeof(float)*Nv, used = (size_t) BatchCount * vectorBytes;
+
+    // Keep the partial vector that followed the previous batch
+    memmove(Batch, (char *) Batch + used, BatchBytes - used);
+    BatchBytes -= used;
+    BatchArrival = omp_get_wtime();
+    int firstRead = 1;
+
+    while (!EndOfStream && BatchBytes < sizeof(Batch)) {
+        struct pollfd request = { .fd = fd, .events = POLLIN };
+        int ready = poll(&request, 1, (BatchBytes >= vectorBytes) ? 0 : -1); // Wait only while no whole vector has arrived
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) { perror("poll"); exit(1); }
+        if (ready == 0) break; // Nothing more is available now, the batch is processed as it is
+
+        ssize_t got = read(fd, (char *) Batch + BatchBytes, sizeof(Batch) - BatchBytes);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) { perror("read"); exit(1); }
+        if (got == 0) { EndOfStream = 1; break; }
+        if (firstRead) BatchArrival = omp_get_wtime(); // The first whole vector of the batch is completed by this read
+        firstRead = 0;
+        BatchBytes += got;
+    }
+
+    BatchCount = (int) (BatchBytes / vectorBytes);
+    if (EndOfStream && BatchCount == 0 && BatchBytes > 0) {
+        printf("WARNING: The stream ended with a partial vector (%zu of %zu bytes), which was dropped\n", BatchBytes, vectorBytes);
+        BatchBytes = 0;
+    }
+    return BatchCount;
+}
+
+
+// *************************************************************************
+// Returns the squared Euclidean distance between two vectors
+// *************************************************************************
+static inline float squaredDistance(const float A[Nv], const float B[Nv]) {
+    float dist = 0;
+
+    #pragma omp simd reduction(+:dist) // If <reduction> is omitted, the compiler protects from math error and does not perform SIMD
+    for (int j=0; j<Nv; j++)
+        dist += (A[j]-B[j]) * (A[j]-B[j]);
+    return dist;
+}
+
+
+// *************************************************************************
+// Updates the classes of the <count> vectors of the batch starting from <first>
+// *************************************************************************
+static inline void classifyTile(int first, int count) {
+    float min_dist[MAX_TILE];
+	int temp_class[MAX_TILE];
+    for (int t=0; t<count; t++) { min_dist[t] = 1e30; temp_class[t] = -1; }
+
+    for (int i=0; i<Nc; i++) {
+        for (int t=0; t<count; t++) { // Center i stays in cache for all the vectors of the tile
+            float dist = squaredDistance(Batch[first+t], Centers[i]); // Distance between Vec and Center i
+
+            if (dist < min_dist[t]) {
+                temp_class[t] = i;
+                min_dist[t] = dist;
+            }
+        }
+    }
+    for (int t=0; t<count; t++)
+        Class_of_Vec[first+t] = temp_class[t]; // Update the current vector's class with the new one
+}
+
+
+// *************************************************************************
+// Classifies the <count> vectors of the batch with the current centers
+// *************************************************************************
+void estimateClasses(int count) {
+    #pragma omp parallel for schedule(static)
+    for (int w=0; w<count; w+=VECTOR_TILE)
+        classifyTile(w, (w+VECTOR_TILE < count) ? VECTOR_TILE : count-w);
+}
+
+
+// ***************************************************
+// Adds the <count> vectors of the batch to their centers in arrival order (MacQueen update)
+// ***************************************************
+void updateCenters(int count) {
+    // The member count that each vector sees depends on the vectors before it, so it is found serially
+    for (int w = 0; w < count; w++)
+        Members_of_Vec[w] = ++Centers_matchings[Class_of_Vec[w]];
+
+    // Every dimension is independent: center += (vector - center) / members, in arrival order
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < Nv; j++)
+        for (int w = 0; w < count; w++)
+            Centers[Class_of_Vec[w]][j] += (Batch[w][j] - Centers[Class_of_Vec[w]][j]) / Members_of_Vec[w];
+}
+
+
+// ***************************************************
+// Takes unique vectors of the batch as initial centers, starting from center <*currentCenter>.
+// Returns the number of vectors of the batch that were examined
+// ***************************************************
+int initCenters(int count, int *currentCenter) {
+    int w = 0;
+    while (w < count && *currentCenter < Nc) {
+        if (notVectorInCenters(Batch[w], *currentCenter)) {
+            for (int i=0; i<Nv; i++)
+                Centers[*currentCenter][i] = Batch[w][i];
+            Centers_matchings[*currentCenter] = 1;
+            (*currentCenter) ++;
+        }
+        w++;
+    }
+    return w;
+}
+
+
+// ***************************************************
+// Compares two doubles (for qsort)
+// ***************************************************
+int compareDoubles(const void *A, const void *B) {
+    double a = *(const double *) A, b = *(const double *) B;
+    return (a > b) - (a < b);
+}
+
+
+// ***************************************************
+// Prints the percentiles of the latencies of batches [first, last)
+// ***************************************************
+void printLatencies(const char *title, long first, long last) {
+    long count = last - first;
+    if (count <= 0) return;
+    double *Sorted = malloc(sizeof(double) * count);
+    memcpy(Sorted, Latencies + first, sizeof(double) * count);
+    qsort(Sorted, count, sizeof(double), compareDoubles);
+    printf("%s batches %6ld-%6ld  LATENCY (ms)  p50: %8.3lf  p90: %8.3lf  p99: %8.3lf  max: %8.3lf\n", title, first+1, last,
+        1e3*Sorted[(count-1)*50/100], 1e3*Sorted[(count-1)*90/100], 1e3*Sorted[(count-1)*99/100], 1e3*Sorted[count-1]);
+    free(Sorted);
+}
+
+
+// ***************************************************
+// Stores the latency of the last batch
+// ***************************************************
+void recordLatency(double seconds) {
+    if (NumOfBatches == LatencyCapacity) {
+        LatencyCapacity = (LatencyCapacity > 0) ? 2*LatencyCapacity : 1024;
+        Latencies = realloc(Latencies, sizeof(double) * LatencyCapacity);
+        if (Latencies == NULL) { printf("ERROR: Out of memory\n"); exit(1); }
+    }
+    Latencies[NumOfBatches++] = seconds;
+}
+
+
+// ***************************************************
+// The main program
+// ***************************************************
+int main( int argc, const char* argv[] ) {
+    const char *inputName = (argc>1) ? argv[1] : "-";
+    const char *outputPrefix = (argc>2) ? argv[2] : DEFAULT_OUTPUT_PREFIX;
+    int input = STDIN_FILENO;
+    long vectors = 0;
+    int centersSet = 0, count;
+
+	printf("--------------------------------------------------------------------------------------------------\n");
+	printf("This program executes the online K-Means algorithm for a stream of vectors.\n");
+	printf("Current configuration has %d Classes, %d Elements per vector and up to %d Vectors per batch.\n", Nc, Nv, BATCH_SIZE);
+	printf("--------------------------------------------------------------------------------------------------\n");
+
+    if (strcmp(inputName, "-") != 0) {
+        input = open(inputName, O_RDONLY); // Opening a FIFO blocks until a writer opens it too
+        if (input < 0) { perror(inputName); return 1; }
+    }
+    printf("Now reading vectors from %s...\n", (input == STDIN_FILENO) ? "the standard input" : inputName);
+
+    double start = omp_get_wtime();
+    while ((count = readBatch(input)) > 0) {
+        vectors += count;
+        if (centersSet < Nc) {  // Still collecting the initial centers, the rest of the batch is processed normally
+            int used = initCenters(count, &centersSet);
+            if (centersSet < Nc) continue;
+            printf("Centers initialized after %ld vectors, now running the main algorithm...\n\n", vectors - count + used);
+            count -= used;
+            memmove(Batch, Batch[used], sizeof(float) * Nv * count);
+            if (count == 0) continue;
+        }
+
+        estimateClasses(count);
+        updateCenters(count);
+        recordLatency(omp_get_wtime() - BatchArrival);
+
+        if (NumOfBatches % REPORT_INTERVAL == 0) printLatencies(">>", NumOfBatches - REPORT_INTERVAL, NumOfBatches);
+        if (NumOfBatches % SNAPSHOT_INTERVAL == 0) snapshotCenters(outputPrefix);
+    }
+    double elapsed = omp_get_wtime() - start;
+    if (input != STDIN_FILENO) close(input);
+
+    if (centersSet < Nc) { printf("ERROR: The stream ended before %d unique vectors were read\n", Nc); return 1; }
+    snapshotCenters(outputPrefix);
+
+    printf("\n\nProcess finished!\n");
+	printf("Vectors read: %ld   Batches processed: %ld   Throughput: %.1lf vectors/s\n", vectors, NumOfBatches, vectors / elapsed);
+    printLatencies("All", 0, NumOfBatches);
+    printf("Centers written to %s_centers.npy\n", outputPrefix);
+    free(Latencies);
+    return 0 ;
+}
+
+//**********************************************************************************************************
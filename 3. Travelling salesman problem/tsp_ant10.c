@@ -0,0 +1,397 @@
+/*
+Description:
+    This program is my implementation of the "Ant Colony" algorithm to solve the "Travelling Salesman Problem"
+    Abides by Lab 3 Exercise 7 requirements
+	
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles/Runs/Debugs with: gcc tsp_ant10.c -o tsp_ant10 -lm -O3 -fopt-info -fopenmp -pg && time ./tsp_ant10 && gprof ./tsp_ant10    
+	Inherits all settings of the previous version unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> The evaporation is lazy: a repetition only advances the counter <Evaporations>. Every pair keeps the time of its
+        last deposit in <TauTimestamp>, and its current tau^ALPHA is the stored one times (1-RHO)^(ALPHA*age), taken from
+        the table <EvaporationToA> (TauToA()). The O(N^2) pow() calls of every repetition are gone
+    --> Every ant deposits 1/(length of its path) only on the N pairs of its path (Ant System), so the pherormone update of
+        a repetition costs O(ANTS*N). The matrix <InvPathDepth> and UpdatePathDepths() were removed (they were never called,
+        so the ants of the previous versions never deposited pherormone)
+*/
+
+
+// ****************************************************************************************************************   
+ 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+
+// **************************************************************************************************************** 
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "stdbool.h"
+#include "omp.h"
+#include "tsp_rng.h"
+#include "tsp_knn.h"
+
+
+// ****************************************************************************************************************
+#define N  10000
+#define Nx 1000
+#define Ny 1000
+#define nonExist -999999
+
+#define ALPHA 0.50 //0.50    // Affects pherormone dependency
+#define BETA  2.00 //0.50  // Affects path length dependency
+#define RHO   0.50 //0.50 
+#define TAU_INITIAL_VALUE 0.50 //0.50
+#define ANTS  100
+
+#define REPETITIONS 8
+#define DEBUG 0
+#define THREADS 12
+#define NEIGHBORS 20      // Candidate cities per city
+#define CITIES_PER_CELL 2 // Average cities per cell of the grid of BuildCandidateLists()
+
+
+
+// ****************************************************************************************************************
+float CitiesX[N];
+float CitiesY[N];
+#define PAIRS ((long long)N*(N-1)/2) // Pairs of different cities
+float CalculatedDistances_to_mBETA[PAIRS];
+float TauValues_to_A[PAIRS]; // Pherormone values between all city pair, at their last deposit
+int TauTimestamp[PAIRS];     // The value of <Evaporations> at the last deposit of every pair
+int Evaporations = 0;        // Evaporations applied so far
+float EvaporationToA[REPETITIONS+1]; // (1-RHO)^(ALPHA*age)
+
+double DistanceTravelled[ANTS]; // The total length of each ant's path
+int AntsPaths[ANTS][N+1]; // The paths of all ants
+int Neighbors[N][NEIGHBORS]; // The nearest cities of each city, closest first
+Rng Streams[THREADS]; // The random number stream of each thread
+double ChoiceInfo[N][NEIGHBORS]; // tau^ALPHA * heta^BETA between every city and its candidates
+
+
+// ****************************************************************************************************************
+// Position of the pair of different cities <I>, <J> in the triangular matrices: the pairs (I,I+1) ... (I,N-1) of
+// row I are consecutive and follow the pairs of row I-1
+// ****************************************************************************************************************
+static inline long long PairIndex(int I, int J) {
+	if (I > J) { int temp = I; I = J; J = temp; }
+	return (long long)I*N - (long long)I*(I+1)/2 + (J-I-1);
+}
+
+
+// ****************************************************************************************************************
+// The current tau^ALPHA of the pair at position <p>: its value at the last deposit, evaporated since then
+// ****************************************************************************************************************
+static inline float TauToA(long long p) {
+	return TauValues_to_A[p] * EvaporationToA[Evaporations - TauTimestamp[p]];
+}
+
+
+
+// ****************************************************************************************************************
+// Prints an int array
+// ****************************************************************************************************************
+void PrintIntArray(int ARRAY[], const int SIZE) {
+	for (int i=0; i<SIZE; i++) {
+		printf("%3d  ", ARRAY[i]);
+	}
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Find min of an double array
+// ****************************************************************************************************************
+double MinOfDoubleArray(double ARRAY[], const int SIZE) {
+	double min = INFINITY;
+	for (int i=0; i<SIZE; i++)
+		if (ARRAY[i] < min) 
+			min = ARRAY[i];
+	return min;
+}
+
+
+// ****************************************************************************************************************
+// Find average of an double array
+// ****************************************************************************************************************
+double AvgOfDoubleArray(double ARRAY[], const int SIZE) {
+	double avg = 0.0;
+	for (int i=0; i<SIZE; i++) avg += ARRAY[i];
+	return avg/SIZE;
+}
+
+
+// ****************************************************************************************************************
+// Prints the cities' positions
+// ****************************************************************************************************************
+void PrintCities() {
+	printf("> The cities are:\n");
+	for (int i=0; i<N; i++) {
+		printf(">> City: %6d  X:%5.2f Y:%5.2f\n", i, CitiesX[i], CitiesY[i] );
+	}
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Prints the travelling sequence of given path
+// ****************************************************************************************************************
+void PrintPath_2(int Path[N+1]) {
+	printf("> The path is:\n");
+	for (int i=0; i<N+1; i++) {
+		printf(">> %d ", Path[i]);
+	}
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Visually maps the cities' positions
+// ****************************************************************************************************************
+void MapCities() {
+	int Map[Ny+1][Nx+1];
+	printf("Now creating a visual map of the cities...\n");
+	for (int i=0; i<Nx+1; i++) 
+		for (int j=0; j<Ny+1; j++) 
+			Map[j][i] = (float) nonExist;
+
+
+	//printf("Quantized coordinates are:\n");
+	for (int c=0; c<N; c++) {
+		int x = (int) CitiesX[c] ;
+		int y = (int) CitiesY[c] ;
+		//printf(" City:%d  y=%d and x=%d\n",c,y,x);
+		if (Map[y][x] == nonExist) Map[y][x] = c;
+		else Map[y][x] = -1;
+	}
+
+	printf("This is the cities' map:\n");
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	for (int y=0; y<Ny+1; y++){
+		for (int x=0; x<Nx+1; x++)
+			printf("%8d ", Map[y][x]);
+		printf("\n");
+	}
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean distance between two cities
+// ****************************************************************************************************************
+double Distance(int A, int B) {
+	return (double) sqrt(   (CitiesX[A]-CitiesX[B])*(CitiesX[A]-CitiesX[B]) + (CitiesY[A]-CitiesY[B])*(CitiesY[A]-CitiesY[B])   );
+}
+
+
+// ****************************************************************************************************************
+// Calculates the choice info (tau^ALPHA * heta^BETA) between every city and each of its candidates
+// ****************************************************************************************************************
+void UpdateChoiceInfo() {
+    #pragma omp parallel for schedule(static) num_threads(THREADS)
+	for (int i=0; i<N; i++)
+		for (int k=0; k<NEIGHBORS; k++) {
+			int j = Neighbors[i][k];
+			long long p = PairIndex(i, j);
+			ChoiceInfo[i][k] = TauToA(p) * CalculatedDistances_to_mBETA[p];
+		}
+}
+
+
+// ****************************************************************************************************************
+// Adds <DeltaTau> to the tau of the pair at position <p>, after the evaporations since its last deposit
+// ****************************************************************************************************************
+void DepositTau(long long p, float DeltaTau) {
+	float newTau = powf(TauToA(p), 1.0f/(float) ALPHA) + DeltaTau;
+	TauValues_to_A[p] = powf(newTau, ALPHA);
+	TauTimestamp[p] = Evaporations;
+}
+
+
+// ****************************************************************************************************************
+// Evaporates the tau values of all pairs of cities (lazily) and adds the pherormone of every ant on the pairs of its path
+// ****************************************************************************************************************
+void CalculateNewTaus() {
+	printf("Now calculating new tau values of the paths of the ants...\n");
+	Evaporations ++;
+	for (int ant=0; ant<ANTS; ant++) {
+		float DeltaTau = 1 / DistanceTravelled[ant];
+		for (int i=0; i<N; i++) DepositTau(PairIndex(AntsPaths[ant][i], AntsPaths[ant][i+1]), DeltaTau);
+	}
+}
+
+
+// ****************************************************************************************************************
+// Initializes the Tau to the power of ALPHA values
+// ****************************************************************************************************************
+void InitializeTauValues_2() {
+	printf("Now initializing the tau values...\n");
+	float initialValue = pow(TAU_INITIAL_VALUE, ALPHA);
+	for (long long p=0; p<PAIRS; p++) { TauValues_to_A[p] = initialValue; TauTimestamp[p] = 0; } //(float) rand() / RAND_MAX;
+	for (int age=0; age<REPETITIONS+1; age++) EvaporationToA[age] = pow(1-RHO, ALPHA*age);
+	printf("> %lld pairs (%.1lf MB per matrix) ===> Completed.\n", PAIRS, PAIRS * sizeof(float) / 1e6);
+}
+
+
+// ****************************************************************************************************************
+// Finds all Eucleidian distances between all pairs of cities (real,  and real^(-BETA) )
+// ****************************************************************************************************************
+void CalculateAllDistances_2() {
+    printf("Now calculating distances and hetas^(BETA) between all pairs of cities...\n");
+    #pragma omp parallel for schedule(dynamic, 50) num_threads(THREADS)
+	for (int i=0; i<N-1; i++) {
+		long long offset = PairIndex(i, i+1) - (i+1); //The pair (i,j>i) is at offset+j
+        #pragma omp simd
+        for (int j=i+1; j<N; j++) {
+		    float dx = CitiesX[i]-CitiesX[j], dy = CitiesY[i]-CitiesY[j];
+            CalculatedDistances_to_mBETA[offset+j] = powf(dx*dx + dy*dy, -BETA/2); //(real^2)^(-BETA/2)
+        }
+	}
+    printf("> ===> Completed.\n");
+}
+
+
+// ****************************************************************************************************************
+// Initializes the cities' positions
+// ****************************************************************************************************************
+void SetCities() {
+	printf("Now initializing the positions of the cities...\n");
+	for (int i=0; i<N; i++) {
+		CitiesX[i] = Nx * (float) rand() / RAND_MAX;
+		CitiesY[i] = Ny * (float) rand() / RAND_MAX;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Builds the lists of the <NEIGHBORS> nearest cities of every city (closest first) with the grid of "tsp_knn.h"
+// ****************************************************************************************************************
+void BuildCandidateLists() {
+	KnnBuild(N, NEIGHBORS, CitiesX, CitiesY, Nx, Ny, CITIES_PER_CELL, &Neighbors[0][0], NULL);
+}
+
+
+// ****************************************************************************************************************
+// Ant <ant> starts finding a path, starting from <starting_city> and drawing from the stream <rng>
+// ****************************************************************************************************************
+void AntRun(int ant, int starting_city, Rng *rng) {
+
+	if (DEBUG==1) printf(">> Ant #%d is now running...\n", ant);
+	double totDist = 0.0;
+    int visited_cities = 1, current_city = starting_city;
+
+    AntsPaths[ant][0] = starting_city; 	AntsPaths[ant][N] = starting_city;
+
+	bool TheAntHasVisitiedCity[N];  
+	for (int i=0; i<N; i++) TheAntHasVisitiedCity[i] = false; 
+	TheAntHasVisitiedCity[starting_city] = true;
+
+    do {
+        if (DEBUG==1) printf("\r>> Progress: %.2f%%", 100*(visited_cities+1)/((float) N) );
+		TheAntHasVisitiedCity[current_city] = true;
+
+        int next_city = -1;
+		double summation = 0.0, Weights[NEIGHBORS];
+
+		// Roulette wheel over the non-visited candidates: each one is picked with possibility proportional to its choice info
+        for (int k=0; k<NEIGHBORS; k++) {
+			Weights[k] = (TheAntHasVisitiedCity[Neighbors[current_city][k]]) ? 0.0 : ChoiceInfo[current_city][k];
+			summation += Weights[k];
+        }
+		if (summation > 0) {
+			double target = RngDouble(rng) * summation;
+			for (int k=0; k<NEIGHBORS; k++) {
+				if (Weights[k] == 0) continue;
+				next_city = Neighbors[current_city][k]; //The last non-visited candidate is kept against rounding errors
+				target -= Weights[k];
+				if (target < 0) break;
+			}
+		}
+		// When every candidate is visited, the roulette wheel runs over every non-visited city
+        else {
+			for (int i=0; i<N; i++)
+				if (!TheAntHasVisitiedCity[i]) { long long p = PairIndex(current_city, i); summation += TauToA(p) * CalculatedDistances_to_mBETA[p]; }
+			double target = RngDouble(rng) * summation;
+			for (int i=0; i<N; i++) {
+				if (TheAntHasVisitiedCity[i]) continue;
+				next_city = i;
+				long long p = PairIndex(current_city, i);
+				target -= TauToA(p) * CalculatedDistances_to_mBETA[p];
+				if (target < 0) break;
+			}
+        }
+        AntsPaths[ant][visited_cities++] = next_city; //Add decided city to current ant's path
+        totDist += Distance(current_city, next_city); //CalculatedDistances[current_city][next_city]; //...add the distance to it
+        current_city = next_city; //...and make it the current city
+		
+    } while (visited_cities < N);
+
+	totDist += Distance(current_city, starting_city);   //CalculatedDistances[current_city][starting_city];
+	DistanceTravelled[ant] = totDist;
+
+    if (DEBUG==1) printf(" ===> Finished\n");
+}
+
+
+// ****************************************************************************************************************
+// The main program
+// ****************************************************************************************************************
+int main( int argc, const char* argv[] ) {
+	printf("------------------------------------------------------------------------------\n");
+	printf("This program searches for the optimal traveling distance between %d cities,\n", N);
+	printf("spanning in an area of X=(0,%d) and Y=(0,%d)\n", Nx, Ny);
+	printf("------------------------------------------------------------------------------\n");
+    
+    srand(1046900);
+    RngStreams(Streams, THREADS, 1046900);
+    SetCities();
+    CalculateAllDistances_2();
+	InitializeTauValues_2();
+	BuildCandidateLists();
+	UpdateChoiceInfo();
+
+	int repetitions = 0;
+	printf("\n~~~~ NOW RUNNING THE MAIN SEQUENCE ~~~~\n==================================================\n");
+	do {
+		printf("Now the ants are running...\n");
+		#pragma omp parallel for schedule(dynamic, 5) num_threads(THREADS)
+		for (int ant=0; ant<ANTS; ant++) {
+            #pragma omp critical
+            printf("ant...\n");
+			Rng *rng = &Streams[omp_get_thread_num()];
+			int starting_city = RngBounded(rng, N);
+			AntRun(ant, starting_city, rng);
+		}
+		CalculateNewTaus();
+		UpdateChoiceInfo();
+
+		printf("REPETITION: %9d   AVERAGE_PATH_LENGTH: %8.3lf\n", ++repetitions, AvgOfDoubleArray(DistanceTravelled, ANTS));
+		printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+		if (DEBUG==1) printf("\n");
+	} while (repetitions < REPETITIONS);
+	printf("\nCalculations completed. Results:\n");
+	printf("Optimal path distance found is: %.2lf\n", MinOfDoubleArray(DistanceTravelled, ANTS));
+    return 0 ;
+}
+
+
+
+
+
+
+
+
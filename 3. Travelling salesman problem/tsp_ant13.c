@@ -0,0 +1,588 @@
+/*
+Description:
+    This program is my implementation of the "Ant Colony" algorithm to solve the "Travelling Salesman Problem"
+    Abides by Lab 3 Exercise 7 requirements
+	
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles/Runs/Debugs with: gcc tsp_ant13.c -o tsp_ant13 -lm -O3 -fopt-info -fopenmp -pg && time ./tsp_ant13 && gprof ./tsp_ant13    
+	Inherits all settings of the previous version unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> <COLONIES> independent colonies (islands): every colony has its own tau values, timestamps, bounds, choice info and
+        best path, <ANTS>/<COLONIES> ants and <THREADS>/<COLONIES> threads (nested parallelism: one outer thread per
+        colony, each one running the parallel loop over the ants of its colony)
+    --> The colonies only meet every <MIGRATION_PERIOD> repetitions: each colony sends its best path to the next one of
+        the ring (MigrateBestPaths()), which keeps it as its own best path and deposits pherormone on it if it is shorter
+    --> The per-thread arrays (streams, 2-opt positions and queues) are indexed by colony*<THREADS>/<COLONIES> + the
+        number of the thread in the colony's team
+    --> The "ant..." line printed by every ant was removed
+*/
+
+
+// ****************************************************************************************************************   
+ 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+
+// **************************************************************************************************************** 
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "stdbool.h"
+#include "omp.h"
+#include "tsp_rng.h"
+#include "tsp_knn.h"
+
+
+// ****************************************************************************************************************
+#define N  10000
+#define Nx 1000
+#define Ny 1000
+#define nonExist -999999
+
+#define ALPHA 1.00 //0.50    // Affects pherormone dependency
+#define BETA  2.00 //0.50  // Affects path length dependency
+#define RHO   0.20 //0.50 
+#define ANTS  100
+#define P_BEST 0.05             // Possibility that a converged colony builds the best path again (sets TauMin)
+#define GLOBAL_BEST_PERIOD 5    // Every <GLOBAL_BEST_PERIOD> repetitions the best path so far deposits pherormone
+
+#define REPETITIONS 50
+#define DEBUG 0
+#define THREADS 12
+#define NEIGHBORS 20      // Candidate cities per city
+#define CITIES_PER_CELL 2 // Average cities per cell of the grid of BuildCandidateLists()
+#define LOCAL_SEARCH 1    // 0: none, 1: 2-opt on the path of every ant
+#define COLONIES 4           // Independent colonies, each one with THREADS/COLONIES threads and ANTS/COLONIES ants
+#define MIGRATION_PERIOD 10  // Every <MIGRATION_PERIOD> repetitions each colony sends its best path to the next one
+#define THREADS_PER_COLONY (THREADS/COLONIES)
+#define ANTS_PER_COLONY (ANTS/COLONIES)
+#define MIN_GAIN 1e-7     // Moves that shorten the path by less than this are ignored (rounding errors)
+
+
+
+// ****************************************************************************************************************
+float CitiesX[N];
+float CitiesY[N];
+#define PAIRS ((long long)N*(N-1)/2) // Pairs of different cities
+float CalculatedDistances_to_mBETA[PAIRS];
+float TauValues_to_A[COLONIES][PAIRS]; // Pherormone values between all city pair, at their last deposit
+int TauTimestamp[COLONIES][PAIRS];     // The value of <Evaporations> at the last deposit of every pair
+int Evaporations[COLONIES];            // Evaporations applied so far
+float EvaporationToA[REPETITIONS+1];   // (1-RHO)^(ALPHA*age)
+float TauMax[COLONIES], TauMin[COLONIES], TauMinToA[COLONIES], TauMaxToA[COLONIES]; // The bounds of tau (MAX-MIN Ant System)
+int ColonyBestPath[COLONIES][N+1];
+double ColonyBestLength[COLONIES];
+int MigrantPath[COLONIES][N+1];        // Copies of the best paths while they migrate
+
+double DistanceTravelled[ANTS]; // The total length of each ant's path
+int AntsPaths[ANTS][N+1]; // The paths of all ants
+int Neighbors[N][NEIGHBORS]; // The nearest cities of each city, closest first
+Rng Streams[THREADS]; // The random number stream of each thread
+double ChoiceInfo[COLONIES][N][NEIGHBORS]; // tau^ALPHA * heta^BETA between every city and its candidates
+
+
+// ****************************************************************************************************************
+// Position of the pair of different cities <I>, <J> in the triangular matrices: the pairs (I,I+1) ... (I,N-1) of
+// row I are consecutive and follow the pairs of row I-1
+// ****************************************************************************************************************
+static inline long long PairIndex(int I, int J) {
+	if (I > J) { int temp = I; I = J; J = temp; }
+	return (long long)I*N - (long long)I*(I+1)/2 + (J-I-1);
+}
+
+
+// ****************************************************************************************************************
+// The current tau^ALPHA of the pair at position <p> in colony <c>: its value at the last deposit, evaporated since then
+// (in [TauMin, TauMax])
+// ****************************************************************************************************************
+static inline float TauToA(int c, long long p) {
+	return fminf(fmaxf(TauValues_to_A[c][p] * EvaporationToA[Evaporations[c] - TauTimestamp[c][p]], TauMinToA[c]), TauMaxToA[c]);
+}
+
+
+
+// ****************************************************************************************************************
+// Prints an int array
+// ****************************************************************************************************************
+void PrintIntArray(int ARRAY[], const int SIZE) {
+	for (int i=0; i<SIZE; i++) {
+		printf("%3d  ", ARRAY[i]);
+	}
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Find min of an double array
+// ****************************************************************************************************************
+double MinOfDoubleArray(double ARRAY[], const int SIZE) {
+	double min = INFINITY;
+	for (int i=0; i<SIZE; i++)
+		if (ARRAY[i] < min) 
+			min = ARRAY[i];
+	return min;
+}
+
+
+// ****************************************************************************************************************
+// Find average of an double array
+// ****************************************************************************************************************
+double AvgOfDoubleArray(double ARRAY[], const int SIZE) {
+	double avg = 0.0;
+	for (int i=0; i<SIZE; i++) avg += ARRAY[i];
+	return avg/SIZE;
+}
+
+
+// ****************************************************************************************************************
+// Prints the cities' positions
+// ****************************************************************************************************************
+void PrintCities() {
+	printf("> The cities are:\n");
+	for (int i=0; i<N; i++) {
+		printf(">> City: %6d  X:%5.2f Y:%5.2f\n", i, CitiesX[i], CitiesY[i] );
+	}
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Prints the travelling sequence of given path
+// ****************************************************************************************************************
+void PrintPath_2(int Path[N+1]) {
+	printf("> The path is:\n");
+	for (int i=0; i<N+1; i++) {
+		printf(">> %d ", Path[i]);
+	}
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Visually maps the cities' positions
+// ****************************************************************************************************************
+void MapCities() {
+	int Map[Ny+1][Nx+1];
+	printf("Now creating a visual map of the cities...\n");
+	for (int i=0; i<Nx+1; i++) 
+		for (int j=0; j<Ny+1; j++) 
+			Map[j][i] = (float) nonExist;
+
+
+	//printf("Quantized coordinates are:\n");
+	for (int c=0; c<N; c++) {
+		int x = (int) CitiesX[c] ;
+		int y = (int) CitiesY[c] ;
+		//printf(" City:%d  y=%d and x=%d\n",c,y,x);
+		if (Map[y][x] == nonExist) Map[y][x] = c;
+		else Map[y][x] = -1;
+	}
+
+	printf("This is the cities' map:\n");
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	for (int y=0; y<Ny+1; y++){
+		for (int x=0; x<Nx+1; x++)
+			printf("%8d ", Map[y][x]);
+		printf("\n");
+	}
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean distance between two cities
+// ****************************************************************************************************************
+double Distance(int A, int B) {
+	return (double) sqrt(   (CitiesX[A]-CitiesX[B])*(CitiesX[A]-CitiesX[B]) + (CitiesY[A]-CitiesY[B])*(CitiesY[A]-CitiesY[B])   );
+}
+
+
+// ****************************************************************************************************************
+// Calculates the choice info (tau^ALPHA * heta^BETA) of colony <c> between every city and each of its candidates
+// ****************************************************************************************************************
+void UpdateChoiceInfo(int c) {
+    #pragma omp parallel for schedule(static) num_threads(THREADS_PER_COLONY)
+	for (int i=0; i<N; i++)
+		for (int k=0; k<NEIGHBORS; k++) {
+			int j = Neighbors[i][k];
+			long long p = PairIndex(i, j);
+			ChoiceInfo[c][i][k] = TauToA(c, p) * CalculatedDistances_to_mBETA[p];
+		}
+}
+
+
+// ****************************************************************************************************************
+// Sets the bounds of tau of colony <c> for a best path of length <length>
+// ****************************************************************************************************************
+void SetTauBounds(int c, double length) {
+	double root = pow(P_BEST, 1.0/N), avg = (NEIGHBORS/2.0 > 2) ? NEIGHBORS/2.0 : 2;
+	TauMax[c] = 1 / (RHO * length);
+	TauMin[c] = TauMax[c] * (1-root) / ((avg-1) * root);
+	if (TauMin[c] > TauMax[c]) TauMin[c] = TauMax[c];
+	TauMinToA[c] = powf(TauMin[c], ALPHA);
+	TauMaxToA[c] = powf(TauMax[c], ALPHA);
+}
+
+
+// ****************************************************************************************************************
+// Adds <DeltaTau> to the tau of the pair at position <p> in colony <c>, after the evaporations since its last deposit
+// (not above TauMax)
+// ****************************************************************************************************************
+void DepositTau(int c, long long p, float DeltaTau) {
+	float newTau = fminf(powf(TauToA(c, p), 1.0f/(float) ALPHA) + DeltaTau, TauMax[c]);
+	TauValues_to_A[c][p] = powf(newTau, ALPHA);
+	TauTimestamp[c][p] = Evaporations[c];
+}
+
+
+// ****************************************************************************************************************
+// Keeps <Path> of length <length> as the best path of colony <c> (and adjusts its bounds of tau)
+// ****************************************************************************************************************
+void SetColonyBestPath(int c, int Path[], double length) {
+	ColonyBestLength[c] = length;
+	for (int i=0; i<N+1; i++) ColonyBestPath[c][i] = Path[i];
+	SetTauBounds(c, length);
+}
+
+
+// ****************************************************************************************************************
+// Evaporates the tau values of colony <c> (lazily) and adds the pherormone of its best ant of repetition <repetition>
+// (or of its best path so far, every <GLOBAL_BEST_PERIOD> repetitions) on the pairs of its path
+// ****************************************************************************************************************
+void CalculateNewTaus(int c, int repetition) {
+	int firstAnt = c*ANTS_PER_COLONY, bestAnt = firstAnt;
+	for (int ant=firstAnt+1; ant<firstAnt+ANTS_PER_COLONY; ant++) if (DistanceTravelled[ant] < DistanceTravelled[bestAnt]) bestAnt = ant;
+	if (DistanceTravelled[bestAnt] < ColonyBestLength[c]) SetColonyBestPath(c, AntsPaths[bestAnt], DistanceTravelled[bestAnt]);
+	bool globalBest = (repetition % GLOBAL_BEST_PERIOD == 0);
+	int *Path = (globalBest) ? ColonyBestPath[c] : AntsPaths[bestAnt];
+	float DeltaTau = 1 / ((globalBest) ? ColonyBestLength[c] : DistanceTravelled[bestAnt]);
+
+	Evaporations[c] ++;
+	for (int i=0; i<N; i++) DepositTau(c, PairIndex(Path[i], Path[i+1]), DeltaTau);
+}
+
+
+// ****************************************************************************************************************
+// Every colony sends its best path to the next colony of the ring. A colony keeps the received path if it is shorter than
+// its own best path, and deposits pherormone on it
+// ****************************************************************************************************************
+void MigrateBestPaths() {
+	double MigrantLength[COLONIES];
+	for (int c=0; c<COLONIES; c++) {
+		MigrantLength[c] = ColonyBestLength[c];
+		for (int i=0; i<N+1; i++) MigrantPath[c][i] = ColonyBestPath[c][i];
+	}
+	for (int c=0; c<COLONIES; c++) {
+		int from = (c + COLONIES - 1) % COLONIES;
+		if (MigrantLength[from] >= ColonyBestLength[c]) continue;
+		SetColonyBestPath(c, MigrantPath[from], MigrantLength[from]);
+		for (int i=0; i<N; i++) DepositTau(c, PairIndex(MigrantPath[from][i], MigrantPath[from][i+1]), 1 / MigrantLength[from]);
+	}
+}
+
+
+// ****************************************************************************************************************
+// Finds the length of the path that always visits the closest non-visited city, starting from city 0
+// ****************************************************************************************************************
+double NearestNeighborPathLength() {
+	bool *CityIsVisited = calloc(N, sizeof(bool));
+	int current_city = 0;
+	double totDist = 0.0;
+	CityIsVisited[current_city] = true;
+	for (int visited_cities=1; visited_cities<N; visited_cities++) {
+		int next_city = -1;
+		for (int k=0; k<NEIGHBORS && next_city<0; k++) //The candidates are sorted, so the first non-visited one is needed
+			if (!CityIsVisited[Neighbors[current_city][k]]) next_city = Neighbors[current_city][k];
+		if (next_city < 0) { //Every candidate is visited, so all cities are scanned
+			double min_dist = INFINITY;
+			for (int i=0; i<N; i++)
+				if (!CityIsVisited[i] && Distance(current_city, i) < min_dist) { min_dist = Distance(current_city, i); next_city = i; }
+		}
+		totDist += Distance(current_city, next_city);
+		CityIsVisited[next_city] = true;
+		current_city = next_city;
+	}
+	free(CityIsVisited);
+	return totDist + Distance(current_city, 0);
+}
+
+
+// ****************************************************************************************************************
+// Initializes the Tau to the power of ALPHA values
+// ****************************************************************************************************************
+void InitializeTauValues_2() {
+	printf("Now initializing the tau values...\n");
+	double length = NearestNeighborPathLength();
+	for (int c=0; c<COLONIES; c++) {
+		SetTauBounds(c, length); ColonyBestLength[c] = INFINITY; Evaporations[c] = 0;
+		float initialValue = pow(TauMax[c], ALPHA);
+		for (long long p=0; p<PAIRS; p++) { TauValues_to_A[c][p] = initialValue; TauTimestamp[c][p] = 0; } //(float) rand() / RAND_MAX;
+	}
+	printf("> Nearest neighbor path: %.2lf  TauMax: %g  TauMin: %g\n", length, TauMax[0], TauMin[0]);
+	for (int age=0; age<REPETITIONS+1; age++) EvaporationToA[age] = pow(1-RHO, ALPHA*age);
+	printf("> %lld pairs (%.1lf MB per matrix, %d colonies) ===> Completed.\n", PAIRS, PAIRS * sizeof(float) / 1e6, COLONIES);
+}
+
+
+// ****************************************************************************************************************
+// Finds all Eucleidian distances between all pairs of cities (real,  and real^(-BETA) )
+// ****************************************************************************************************************
+void CalculateAllDistances_2() {
+    printf("Now calculating distances and hetas^(BETA) between all pairs of cities...\n");
+    #pragma omp parallel for schedule(dynamic, 50) num_threads(THREADS)
+	for (int i=0; i<N-1; i++) {
+		long long offset = PairIndex(i, i+1) - (i+1); //The pair (i,j>i) is at offset+j
+        #pragma omp simd
+        for (int j=i+1; j<N; j++) {
+		    float dx = CitiesX[i]-CitiesX[j], dy = CitiesY[i]-CitiesY[j];
+            CalculatedDistances_to_mBETA[offset+j] = powf(dx*dx + dy*dy, -BETA/2); //(real^2)^(-BETA/2)
+        }
+	}
+    printf("> ===> Completed.\n");
+}
+
+
+// ****************************************************************************************************************
+// Initializes the cities' positions
+// ****************************************************************************************************************
+void SetCities() {
+	printf("Now initializing the positions of the cities...\n");
+	for (int i=0; i<N; i++) {
+		CitiesX[i] = Nx * (float) rand() / RAND_MAX;
+		CitiesY[i] = Ny * (float) rand() / RAND_MAX;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Builds the lists of the <NEIGHBORS> nearest cities of every city (closest first) with the grid of "tsp_knn.h"
+// ****************************************************************************************************************
+void BuildCandidateLists() {
+	KnnBuild(N, NEIGHBORS, CitiesX, CitiesY, Nx, Ny, CITIES_PER_CELL, &Neighbors[0][0], NULL);
+}
+
+
+// ****************************************************************************************************************
+// Ant <ant> of colony <c> starts finding a path, starting from <starting_city> and drawing from the stream <rng>
+// ****************************************************************************************************************
+void AntRun(int c, int ant, int starting_city, Rng *rng) {
+
+	if (DEBUG==1) printf(">> Ant #%d is now running...\n", ant);
+	double totDist = 0.0;
+    int visited_cities = 1, current_city = starting_city;
+
+    AntsPaths[ant][0] = starting_city; 	AntsPaths[ant][N] = starting_city;
+
+	bool TheAntHasVisitiedCity[N];  
+	for (int i=0; i<N; i++) TheAntHasVisitiedCity[i] = false; 
+	TheAntHasVisitiedCity[starting_city] = true;
+
+    do {
+        if (DEBUG==1) printf("\r>> Progress: %.2f%%", 100*(visited_cities+1)/((float) N) );
+		TheAntHasVisitiedCity[current_city] = true;
+
+        int next_city = -1;
+		double summation = 0.0, Weights[NEIGHBORS];
+
+		// Roulette wheel over the non-visited candidates: each one is picked with possibility proportional to its choice info
+        for (int k=0; k<NEIGHBORS; k++) {
+			Weights[k] = (TheAntHasVisitiedCity[Neighbors[current_city][k]]) ? 0.0 : ChoiceInfo[c][current_city][k];
+			summation += Weights[k];
+        }
+		if (summation > 0) {
+			double target = RngDouble(rng) * summation;
+			for (int k=0; k<NEIGHBORS; k++) {
+				if (Weights[k] == 0) continue;
+				next_city = Neighbors[current_city][k]; //The last non-visited candidate is kept against rounding errors
+				target -= Weights[k];
+				if (target < 0) break;
+			}
+		}
+		// When every candidate is visited, the roulette wheel runs over every non-visited city
+        else {
+			for (int i=0; i<N; i++)
+				if (!TheAntHasVisitiedCity[i]) { long long p = PairIndex(current_city, i); summation += TauToA(c, p) * CalculatedDistances_to_mBETA[p]; }
+			double target = RngDouble(rng) * summation;
+			for (int i=0; i<N; i++) {
+				if (TheAntHasVisitiedCity[i]) continue;
+				next_city = i;
+				long long p = PairIndex(current_city, i);
+				target -= TauToA(c, p) * CalculatedDistances_to_mBETA[p];
+				if (target < 0) break;
+			}
+        }
+        AntsPaths[ant][visited_cities++] = next_city; //Add decided city to current ant's path
+        totDist += Distance(current_city, next_city); //CalculatedDistances[current_city][next_city]; //...add the distance to it
+        current_city = next_city; //...and make it the current city
+		
+    } while (visited_cities < N);
+
+	totDist += Distance(current_city, starting_city);   //CalculatedDistances[current_city][starting_city];
+	DistanceTravelled[ant] = totDist;
+
+    if (DEBUG==1) printf(" ===> Finished\n");
+}
+
+
+// ****************************************************************************************************************
+// The positions of the cities in the path of the ant of every thread, and the queue of the cities whose don't-look
+// bit is off (<InQueue>)
+// ****************************************************************************************************************
+int PositionOfCity[THREADS][N];
+int Queue[THREADS][N], QueueHead[THREADS], QueueSize[THREADS];
+bool InQueue[THREADS][N];
+long long TwoOptMoves[THREADS];
+
+void Push(int t, int city) {
+	if (InQueue[t][city]) return;
+	Queue[t][(QueueHead[t] + QueueSize[t]++) % N] = city; InQueue[t][city] = true;
+}
+
+int Pop(int t) {
+	int city = Queue[t][QueueHead[t]]; QueueHead[t] = (QueueHead[t]+1) % N; QueueSize[t]--;
+	InQueue[t][city] = false;
+	return city;
+}
+
+
+// ****************************************************************************************************************
+// Reverses the part of <Path> from position <i> to position <j> (both included, wrapping around the end of the path),
+// or the rest of the path if it is shorter
+// ****************************************************************************************************************
+void ReversePath(int Path[], int Position[], int i, int j) {
+	int length = (j - i + N) % N + 1;
+	if (2*length > N) { int temp = i; i = (j+1) % N; j = (temp-1+N) % N; length = N - length; }
+	for (int s=0; s<length/2; s++) {
+		int A = Path[i], B = Path[j];
+		Path[i] = B; Position[B] = i;
+		Path[j] = A; Position[A] = j;
+		i = (i+1 < N) ? i+1 : 0;
+		j = (j > 0) ? j-1 : N-1;
+	}
+	Path[N] = Path[0];
+}
+
+
+// ****************************************************************************************************************
+// Applies improving 2-opt moves on the path of ant <ant>, using the arrays of thread <t>, until none is left. Returns
+// the total change of the path distance. For the city A with path neighbor B (next or previous) and a candidate city C
+// with path neighbor D (on the same side), the edges A-B and C-D are replaced by A-C and B-D
+// ****************************************************************************************************************
+double TwoOpt(int ant, int t) {
+	int *Path = AntsPaths[ant], *Position = PositionOfCity[t];
+	double totDistChange = 0.0;
+	for (int i=0; i<N; i++) { Position[Path[i]] = i; InQueue[t][Path[i]] = false; }
+	QueueHead[t] = 0; QueueSize[t] = 0;
+	for (int i=0; i<N; i++) Push(t, Path[i]);
+
+	while (QueueSize[t] > 0) {
+		int A = Pop(t);
+		bool improved = false;
+		for (int direction=0; direction<2 && !improved; direction++) { // 0: A-B is followed by the path, 1: B-A
+			int B = (direction==0) ? Path[Position[A]+1] : Path[(Position[A]>0) ? Position[A]-1 : N-1];
+			double dist1_old = Distance(A, B);
+			for (int k=0; k<NEIGHBORS; k++) {
+				int C = Neighbors[A][k];
+				double dist1_new = Distance(A, C);
+				if (dist1_new >= dist1_old) break; //The candidates are sorted, so no other move can shorten the path
+				int D = (direction==0) ? Path[Position[C]+1] : Path[(Position[C]>0) ? Position[C]-1 : N-1];
+				if (C == B || D == A) continue;
+				double dist2_old = Distance(C, D);
+				double dist2_new = Distance(B, D);
+				double distChange = - dist1_old - dist2_old + dist1_new + dist2_new;
+				if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+					if (direction==0) ReversePath(Path, Position, Position[B], Position[C]); // A B ... C D -> A C ... B D
+					else ReversePath(Path, Position, Position[A], Position[D]);              // B A ... D C -> B D ... A C
+					Push(t, A); Push(t, B); Push(t, C); Push(t, D);
+					totDistChange += distChange; TwoOptMoves[t] ++;
+					improved = true;
+					break;
+				}
+			}
+		}
+	}
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// The main program
+// ****************************************************************************************************************
+int main( int argc, const char* argv[] ) {
+	printf("------------------------------------------------------------------------------\n");
+	printf("This program searches for the optimal traveling distance between %d cities,\n", N);
+	printf("spanning in an area of X=(0,%d) and Y=(0,%d)\n", Nx, Ny);
+	printf("------------------------------------------------------------------------------\n");
+    
+    srand(1046900);
+    RngStreams(Streams, THREADS, 1046900);
+    SetCities();
+    CalculateAllDistances_2();
+	BuildCandidateLists();
+	InitializeTauValues_2();
+
+	if (THREADS % COLONIES != 0 || ANTS % COLONIES != 0) {
+		printf("\nERROR: THREADS AND ANTS MUST BE DIVIDED EQUALLY AMONG THE COLONIES\nThe program will now exit.\n"); return 1; }
+	omp_set_max_active_levels(2);
+
+	printf("\n~~~~ NOW RUNNING THE MAIN SEQUENCE (%d colonies of %d ants) ~~~~\n==================================================\n", COLONIES, ANTS_PER_COLONY);
+	#pragma omp parallel num_threads(COLONIES)
+	{
+		int c = omp_get_thread_num();
+		UpdateChoiceInfo(c);
+		for (int repetitions=1; repetitions<=REPETITIONS; repetitions++) {
+			#pragma omp parallel for schedule(dynamic, 1) num_threads(THREADS_PER_COLONY)
+			for (int ant=c*ANTS_PER_COLONY; ant<(c+1)*ANTS_PER_COLONY; ant++) {
+				int t = c*THREADS_PER_COLONY + omp_get_thread_num();
+				Rng *rng = &Streams[t];
+				int starting_city = RngBounded(rng, N);
+				AntRun(c, ant, starting_city, rng);
+				if (LOCAL_SEARCH == 1) DistanceTravelled[ant] += TwoOpt(ant, t);
+			}
+			CalculateNewTaus(c, repetitions);
+			if (repetitions % MIGRATION_PERIOD == 0) {
+				#pragma omp barrier
+				#pragma omp single
+				MigrateBestPaths();
+			}
+			UpdateChoiceInfo(c);
+
+			#pragma omp critical
+			printf("COLONY: %2d   REPETITION: %9d   AVERAGE_PATH_LENGTH: %8.3lf   BEST_PATH_LENGTH: %8.3lf\n", c, repetitions, AvgOfDoubleArray(&DistanceTravelled[c*ANTS_PER_COLONY], ANTS_PER_COLONY), ColonyBestLength[c]);
+		}
+	}
+
+	int bestColony = 0;
+	for (int c=1; c<COLONIES; c++) if (ColonyBestLength[c] < ColonyBestLength[bestColony]) bestColony = c;
+	printf("\nCalculations completed. Results:\n");
+	long long moves = 0; for (int t=0; t<THREADS; t++) moves += TwoOptMoves[t];
+	if (LOCAL_SEARCH == 1) printf("2-opt moves applied: %lld\n", moves);
+	for (int c=0; c<COLONIES; c++) printf("> Colony %2d best path: %.2lf\n", c, ColonyBestLength[c]);
+	printf("Optimal path distance found is: %.2lf\n", ColonyBestLength[bestColony]);
+	double actualLength = 0.0; for (int i=0; i<N; i++) actualLength += Distance(ColonyBestPath[bestColony][i], ColonyBestPath[bestColony][i+1]);
+	printf("Actual length of the best path: %.2lf\n", actualLength);
+    return 0 ;
+}
+
+
+
+
+
+
+
+
@@ -0,0 +1,629 @@
+/*
+Description:
+    This program solves large "Travelling Salesman Problem" instances by spatial decomposition: the cities are split in
+	regions with my K-Means implementation (kmeans13), every region is solved independently ("Heinritz Hsiao" path and
+	2-opt) as an OpenMP task, and the paths of the regions are stitched into one path that is repaired by a 2-opt local
+	search around the borders of the regions
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles/Runs/Debugs with: gcc tsp_cluster01.c -o tsp_cluster01 -lm -O3 -fopt-info -fopenmp -pg && time ./tsp_cluster01 && gprof ./tsp_cluster01
+    Executes the algorithm for 1.000.000 cities, spanning in an area of 1.000x1.000 km
+    --> K-Means (estimateClasses() / estimateCenters() of kmeans13 for vectors of 2 dimensions, the positions of the cities)
+        splits the cities in <REGIONS> regions; the sums of the centers are kept in doubles, since the float sums of
+        kmeans13 lose precision for ~4000 cities per region. estimateCenters() sums the cities in parallel, every thread into
+        its own copy of the sums (array reduction)
+    --> The regions are visited in the order of a short path over their centers (closest center and 2-opt,
+        OrderRegions()). Every region is entered at its city closest to the center of the previous region and left at its
+        city closest to the center of the next one (SetPortals()), so the regions can be solved independently
+    --> Every region is an OpenMP task (the largest regions first) that writes its path directly into its part of <Path>:
+        a closest / second closest city path from the entry to the exit city (candidate lists, a scan of the region's
+        cities when the candidates are visited), then a 2-opt local search that keeps both ends in place (TwoOptInRange())
+    --> The stitches are repaired in parallel (RepairStitches()): the window of the stitch of two consecutive regions is
+        the part of <Path> of both regions, improved by TwoOptInRange() with candidates of both. The windows of the even
+        stitches do not overlap, so they run in parallel, and then the ones of the odd stitches
+    --> The rest of the path is repaired by the serial 2-opt local search of tsp_opt01 (whole path), whose queue only holds
+        the cities that have a candidate in a region that is not next to their own in the path order (RepairBorders()):
+        42744 instead of 75017 cities, 4769 instead of 9894 moves. A 2-opt move there may reverse a part of the path that
+        crosses any number of regions, so this pass is kept serial
+    --> On one core the phases took 3.3 s (candidate lists), 12.0 s (K-Means), 3.2 s (regions), 1.1 s (stitches) and
+        2.0 s (serial repair, 3.6 s before the stitches were repaired), and the path is 780116 instead of 785299 long.
+        The serial ~9% of the 21.6 s lets the program run at most ~11 times faster (Amdahl), ~5.9 times on 12 threads
+*/
+
+
+// **************************************************************************************************************** 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// **************************************************************************************************************** 
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "omp.h"
+#include "stdbool.h"
+#include "tsp_rng.h"
+#include "tsp_knn.h"
+
+
+// ****************************************************************************************************************
+#define N  1000000
+#define Nx 1000
+#define Ny 1000
+#define THREADS 12
+#define REGIONS 256              // Regions (K-Means classes), ~4000 cities each
+#define THRESHOLD 0.000001       // K-Means stops when the distances improve less than this (relatively)
+#define KMEANS_REPETITIONS 20    // Maximum K-Means repetitions
+#define PICK_CLOSEST_CITY_POSSIBILITY 0.90
+#define NEIGHBORS 10             // Candidate cities per city
+#define CITIES_PER_CELL 2        // Average cities per cell of the grid of BuildCandidateLists()
+#define MIN_GAIN 1e-7            // Moves that shorten the path by less than this are ignored (rounding errors)
+
+
+// ****************************************************************************************************************
+float CitiesX[N];
+float CitiesY[N];
+int Path[N+1];
+int PositionOfCity[N];
+int Neighbors[N][NEIGHBORS]; // The nearest cities of each city, closest first
+double NeighborDistances[N][NEIGHBORS]; // The distances of the cities in <Neighbors>, as given by Distance()
+bool CityIsVisited[N];
+Rng Streams[REGIONS];        // The random number stream of each region
+
+float CentersX[REGIONS], CentersY[REGIONS]; // The centers of the regions
+int RegionOfCity[N];
+int RegionStart[REGIONS+1], RegionCities[N]; // The cities of region r are RegionCities[RegionStart[r]...RegionStart[r+1]-1]
+int RegionOrder[REGIONS], RegionOffset[REGIONS], NonEmptyRegions; // The regions in the order of the path and their parts of <Path>
+int RegionEntry[REGIONS], RegionExit[REGIONS]; // The first and last city of every region in the path
+
+
+// ****************************************************************************************************************
+// Initializes the cities' positions
+// ****************************************************************************************************************
+void SetCities() {
+	printf("Now initializing the positions of the cities...\n");
+	for (int i=0; i<N; i++) {
+		CitiesX[i] = Nx * (float) rand() / RAND_MAX;
+		CitiesY[i] = Ny * (float) rand() / RAND_MAX;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean distance between two cities
+// ****************************************************************************************************************
+double Distance(int A, int B) {
+	return (double) sqrt(   (CitiesX[A]-CitiesX[B])*(CitiesX[A]-CitiesX[B]) + (CitiesY[A]-CitiesY[B])*(CitiesY[A]-CitiesY[B])   );
+}
+
+
+// ****************************************************************************************************************
+// Finds Eucleidian distance in a given path
+// ****************************************************************************************************************
+double PathDistance_2(int Path[]) {
+	double totDist = 0.0;
+	for (int i=0; i<N; i++) {
+		totDist += Distance(Path[i], Path[i+1]);
+	}
+	return totDist;
+}
+
+
+// ****************************************************************************************************************
+// Builds the lists of the <NEIGHBORS> nearest cities of every city (closest first) with the grid of "tsp_knn.h", and
+// their distances as given by Distance()
+// ****************************************************************************************************************
+void BuildCandidateLists() {
+	KnnBuild(N, NEIGHBORS, CitiesX, CitiesY, Nx, Ny, CITIES_PER_CELL, &Neighbors[0][0], NULL);
+	#pragma omp parallel for schedule(static)
+	for (int c=0; c<N; c++)
+		for (int k=0; k<NEIGHBORS; k++) NeighborDistances[c][k] = Distance(c, Neighbors[c][k]); // The gains of the moves mix both
+}
+
+
+// ****************************************************************************************************************
+// Returns 1 if <city> is not at the position of one of the first <maxIndex> centers
+// ****************************************************************************************************************
+int notCityInCenters(int city, int maxIndex) {
+	for (int c=0; c<maxIndex; c++)
+		if (CitiesX[city] == CentersX[c] && CitiesY[city] == CentersY[c]) return 0;
+	return 1;
+}
+
+
+// ****************************************************************************************************************
+// Picks a new center when the center <indexOfCenterToChange> has no cities
+// ****************************************************************************************************************
+void pickSubstituteCenter(int indexOfCenterToChange) {
+	printf("> Now searching for a substitute center...\n");
+	for (int city=0; city<N; city++)
+		if (notCityInCenters(city, REGIONS)) {
+			CentersX[indexOfCenterToChange] = CitiesX[city]; CentersY[indexOfCenterToChange] = CitiesY[city];
+			return;
+		}
+}
+
+
+// ****************************************************************************************************************
+// Chooses the first unique <REGIONS> cities as centers (the cities are random, so the centers are too)
+// ****************************************************************************************************************
+void initCenters2() {
+	int currentCenter=0, currentCity=0;
+	do {
+		if (notCityInCenters(currentCity, currentCenter)) {
+			CentersX[currentCenter] = CitiesX[currentCity]; CentersY[currentCenter] = CitiesY[currentCity];
+			currentCenter ++;
+		}
+		currentCity++;
+	} while (currentCenter<REGIONS);
+}
+
+
+// ****************************************************************************************************************
+// Assigns every city to its closest center. Returns the sum of distances between all cities and their centers
+// ****************************************************************************************************************
+float estimateClasses() {
+	float tot_min_distances = 0;
+
+	#pragma omp parallel for reduction(+:tot_min_distances) schedule(static) num_threads(THREADS)
+	for (int w=0; w<N; w++) {
+		float min_dist = 1e30;
+		int temp_class = -1;
+		for (int i=0; i<REGIONS; i++) {
+			float dist = (CitiesX[w]-CentersX[i])*(CitiesX[w]-CentersX[i]) + (CitiesY[w]-CentersY[i])*(CitiesY[w]-CentersY[i]);
+			if (dist < min_dist) {
+				temp_class = i;
+				min_dist = dist;
+			}
+		}
+		RegionOfCity[w] = temp_class; // Update the current city's region with the new one
+		tot_min_distances += sqrt(min_dist); // Increase the sum of distances
+	}
+	return tot_min_distances;
+}
+
+
+// ****************************************************************************************************************
+// Finds the new centers
+// ****************************************************************************************************************
+void estimateCenters() {
+	int Centers_matchings[REGIONS] = {0};
+	double SumX[REGIONS] = {0}, SumY[REGIONS] = {0};
+	int needToRecalculateCenters = 0;
+
+	// Add each city's position to its corresponding center (every thread sums its own block of cities)
+	#pragma omp parallel for reduction(+:Centers_matchings[:REGIONS], SumX[:REGIONS], SumY[:REGIONS]) schedule(static) num_threads(THREADS)
+	for (int w=0; w<N; w++) {
+		Centers_matchings[RegionOfCity[w]] ++;
+		SumX[RegionOfCity[w]] += CitiesX[w]; SumY[RegionOfCity[w]] += CitiesY[w];
+	}
+
+	for (int i=0; i<REGIONS; i++) {
+		if (Centers_matchings[i] != 0) {
+			CentersX[i] = SumX[i] / Centers_matchings[i]; CentersY[i] = SumY[i] / Centers_matchings[i];
+		}
+		else {
+			printf("\nWARNING: Center %d has no members.\n", i);
+			pickSubstituteCenter(i);
+			needToRecalculateCenters = 1;
+			break;
+		}
+	}
+	if (needToRecalculateCenters == 1) { estimateClasses(); estimateCenters(); }
+}
+
+
+// ****************************************************************************************************************
+// Splits the cities in <REGIONS> regions with K-Means and groups the cities of every region (counting sort)
+// ****************************************************************************************************************
+void SplitInRegions() {
+	printf("Now splitting the cities in %d regions (K-Means)...\n", REGIONS);
+	int repetitions = 0;
+	float totDist = 1.0e30, prevDist, diff;
+	initCenters2();
+	do {
+		repetitions++;
+		prevDist = totDist;
+		totDist = estimateClasses();
+		estimateCenters();
+		diff = (prevDist-totDist)/totDist;
+		printf(">> REPETITION: %3d  ||  DISTANCE IMPROVEMENT: %.6f \n", repetitions, diff);
+	} while ((diff > THRESHOLD) && (repetitions < KMEANS_REPETITIONS));
+	estimateClasses(); //The regions of the final centers
+
+	for (int r=0; r<REGIONS+1; r++) RegionStart[r] = 0;
+	for (int c=0; c<N; c++) RegionStart[RegionOfCity[c]+1] ++;
+	for (int r=0; r<REGIONS; r++) RegionStart[r+1] += RegionStart[r];
+	int Fill[REGIONS];
+	for (int r=0; r<REGIONS; r++) Fill[r] = RegionStart[r];
+	for (int c=0; c<N; c++) RegionCities[Fill[RegionOfCity[c]]++] = c;
+}
+
+
+// ****************************************************************************************************************
+// Orders the non-empty regions by a short path over their centers: closest center first, then 2-opt moves until none
+// shortens the path
+// ****************************************************************************************************************
+double CenterDistance(int A, int B) {
+	return sqrt( (CentersX[A]-CentersX[B])*(CentersX[A]-CentersX[B]) + (CentersY[A]-CentersY[B])*(CentersY[A]-CentersY[B]) );
+}
+
+void OrderRegions() {
+	bool Ordered[REGIONS];
+	NonEmptyRegions = 0;
+	for (int r=0; r<REGIONS; r++) Ordered[r] = (RegionStart[r+1] == RegionStart[r]);
+	for (int r=0; r<REGIONS && NonEmptyRegions==0; r++) if (!Ordered[r]) { RegionOrder[NonEmptyRegions++] = r; Ordered[r] = true; }
+	while (true) {
+		int current = RegionOrder[NonEmptyRegions-1], next = -1;
+		for (int r=0; r<REGIONS; r++)
+			if (!Ordered[r] && (next < 0 || CenterDistance(current, r) < CenterDistance(current, next))) next = r;
+		if (next < 0) break;
+		RegionOrder[NonEmptyRegions++] = next; Ordered[next] = true;
+	}
+	int R = NonEmptyRegions;
+	bool improved = (R > 3);
+	while (improved) {
+		improved = false;
+		for (int i=0; i<R-1; i++)
+			for (int j=i+2; j<R; j++) {
+				int A = RegionOrder[i], B = RegionOrder[i+1], C = RegionOrder[j], D = RegionOrder[(j+1) % R];
+				if (A == D) continue;
+				if (CenterDistance(A, C) + CenterDistance(B, D) < CenterDistance(A, B) + CenterDistance(C, D) - MIN_GAIN) {
+					for (int s=i+1, e=j; s<e; s++, e--) { int temp = RegionOrder[s]; RegionOrder[s] = RegionOrder[e]; RegionOrder[e] = temp; }
+					improved = true;
+				}
+			}
+	}
+	for (int k=0, offset=0; k<R; k++) { RegionOffset[k] = offset; offset += RegionStart[RegionOrder[k]+1] - RegionStart[RegionOrder[k]]; }
+}
+
+
+// ****************************************************************************************************************
+// Sets the entry (closest to the center of the previous region) and the exit city (closest to the center of the next
+// region) of every region. They differ when the region has more than one city
+// ****************************************************************************************************************
+void SetPortals() {
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(THREADS)
+	for (int k=0; k<NonEmptyRegions; k++) {
+		int r = RegionOrder[k], prev = RegionOrder[(k + NonEmptyRegions - 1) % NonEmptyRegions], next = RegionOrder[(k+1) % NonEmptyRegions];
+		int entry_city = -1, exit_city = -1;
+		float entryDist = INFINITY, exitDist = INFINITY;
+		for (int i=RegionStart[r]; i<RegionStart[r+1]; i++) {
+			int c = RegionCities[i];
+			float dist = (CitiesX[c]-CentersX[prev])*(CitiesX[c]-CentersX[prev]) + (CitiesY[c]-CentersY[prev])*(CitiesY[c]-CentersY[prev]);
+			if (dist < entryDist) { entryDist = dist; entry_city = c; }
+		}
+		for (int i=RegionStart[r]; i<RegionStart[r+1]; i++) {
+			int c = RegionCities[i];
+			if (c == entry_city && RegionStart[r+1] - RegionStart[r] > 1) continue;
+			float dist = (CitiesX[c]-CentersX[next])*(CitiesX[c]-CentersX[next]) + (CitiesY[c]-CentersY[next])*(CitiesY[c]-CentersY[next]);
+			if (dist < exitDist) { exitDist = dist; exit_city = c; }
+		}
+		RegionEntry[r] = entry_city; RegionExit[r] = exit_city;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Reverses the part of <Path> from position <i> to position <j> (i<j, no wrapping around the end of the path)
+// ****************************************************************************************************************
+void ReverseRange(int i, int j) {
+	for (; i<j; i++, j--) {
+		int A = Path[i], B = Path[j];
+		Path[i] = B; PositionOfCity[B] = i;
+		Path[j] = A; PositionOfCity[A] = j;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Applies improving 2-opt moves to the part of <Path> from position <first> to position <last>, keeping the cities of
+// both ends in place: only the edges inside the part are replaced, with candidates of the regions <r1> and <r2> (the
+// part must hold all their cities). <Queue> (at least last-first+1 cities) holds the cities whose don't-look bit is
+// off. Returns the total change of the path distance
+// ****************************************************************************************************************
+double TwoOptInRange(int first, int last, int r1, int r2, int Queue[]) {
+	int size = last - first + 1, head = 0, queued = 0;
+	double totDistChange = 0.0;
+	for (int i=first; i<=last; i++) { Queue[queued++] = Path[i]; CityIsVisited[Path[i]] = true; } //<CityIsVisited> marks the queued cities here
+
+	while (queued > 0) {
+		int A = Queue[head]; head = (head+1) % size; queued--;
+		CityIsVisited[A] = false;
+		bool improved = false;
+		for (int direction=0; direction<2 && !improved; direction++) { // 0: A-B is followed by the path, 1: B-A
+			int edge1 = (direction==0) ? PositionOfCity[A] : PositionOfCity[A]-1; // The edge from position <edge1> to <edge1>+1
+			if (edge1 < first || edge1 >= last) continue;
+			int B = (direction==0) ? Path[edge1+1] : Path[edge1];
+			double dist1_old = Distance(A, B);
+			for (int k=0; k<NEIGHBORS; k++) {
+				int C = Neighbors[A][k];
+				double dist1_new = NeighborDistances[A][k];
+				if (dist1_new >= dist1_old) break; //The candidates are sorted, so no other move can shorten the path
+				if (RegionOfCity[C] != r1 && RegionOfCity[C] != r2) continue; //Its position may be written by another task
+				int edge2 = (direction==0) ? PositionOfCity[C] : PositionOfCity[C]-1;
+				if (edge2 < first || edge2 >= last || edge2 == edge1) continue;
+				int D = (direction==0) ? Path[edge2+1] : Path[edge2];
+				if (C == B || D == A) continue;
+				double dist2_old = Distance(C, D);
+				double dist2_new = Distance(B, D);
+				double distChange = - dist1_old - dist2_old + dist1_new + dist2_new;
+				if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+					if (edge1 < edge2) ReverseRange(edge1+1, edge2); else ReverseRange(edge2+1, edge1); // The edges become A-C and B-D
+					int Moved[4] = {A, B, C, D};
+					for (int m=0; m<4; m++) if (!CityIsVisited[Moved[m]]) { Queue[(head + queued++) % size] = Moved[m]; CityIsVisited[Moved[m]] = true; }
+					totDistChange += distChange;
+					improved = true;
+					break;
+				}
+			}
+		}
+	}
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// Solves region <r> into <Path> from position <offset>: a path from its entry to its exit city that visits the closest
+// or the second closest non-visited city of the region each time, improved by 2-opt. Returns the length of the path
+// ****************************************************************************************************************
+double SolveRegion(int r, int offset, Rng *rng) {
+	int size = RegionStart[r+1] - RegionStart[r], *Cities = &RegionCities[RegionStart[r]];
+	int entry_city = RegionEntry[r], exit_city = RegionExit[r], current_city = entry_city;
+	double totDist = 0.0;
+	for (int i=0; i<size; i++) CityIsVisited[Cities[i]] = false;
+	Path[offset] = entry_city; PositionOfCity[entry_city] = offset;
+	CityIsVisited[entry_city] = true; CityIsVisited[exit_city] = true; //The exit city is kept for the end
+
+	for (int visited_cities=1; visited_cities<size-1; visited_cities++) {
+		int closest_city_1 = -1, closest_city_2 = -1;
+		double min_dist_1 = INFINITY, min_dist_2 = INFINITY;
+		for (int k=0; k<NEIGHBORS && closest_city_2<0; k++) { //The candidates are sorted, so the first two non-visited ones are needed
+			int i = Neighbors[current_city][k];
+			if (RegionOfCity[i] != r || CityIsVisited[i]) continue;
+			if (closest_city_1 < 0) { min_dist_1 = NeighborDistances[current_city][k]; closest_city_1 = i; }
+			else { min_dist_2 = NeighborDistances[current_city][k]; closest_city_2 = i; }
+		}
+		if (closest_city_2 < 0) { //Fewer than two candidates are left, so all cities of the region are scanned
+			closest_city_1 = -1; min_dist_1 = INFINITY;
+			for (int i=0; i<size; i++) {
+				int c = Cities[i];
+				if (CityIsVisited[c]) continue;
+				double dist = Distance(current_city, c);
+				if (dist < min_dist_1) { min_dist_2 = min_dist_1; closest_city_2 = closest_city_1; min_dist_1 = dist; closest_city_1 = c; }
+				else if (dist < min_dist_2) { min_dist_2 = dist; closest_city_2 = c; }
+			}
+		}
+		float random_number = RngFloat(rng);
+		int city_pick = (random_number<PICK_CLOSEST_CITY_POSSIBILITY || closest_city_2<0) ? 1 : 2;
+		int next_city = (city_pick==1) ? closest_city_1 : closest_city_2;
+		Path[offset+visited_cities] = next_city; PositionOfCity[next_city] = offset+visited_cities;
+		CityIsVisited[next_city] = true;
+		current_city = next_city;
+		totDist += (city_pick==1) ? min_dist_1 : min_dist_2;
+	}
+	if (size > 1) {
+		Path[offset+size-1] = exit_city; PositionOfCity[exit_city] = offset+size-1;
+		totDist += Distance(current_city, exit_city);
+	}
+
+	int *Queue = malloc(sizeof(int) * size);
+	totDist += TwoOptInRange(offset, offset+size-1, r, r, Queue);
+	free(Queue);
+	return totDist;
+}
+
+
+// ****************************************************************************************************************
+// Solves every region as an OpenMP task (the largest regions first) and stitches the paths of the regions in <Path>.
+// Returns the length of the stitched path
+// ****************************************************************************************************************
+int CompareRegionSizes(const void *A, const void *B) {
+	int a = *(const int *)A, b = *(const int *)B;
+	int sizeA = RegionStart[RegionOrder[a]+1] - RegionStart[RegionOrder[a]], sizeB = RegionStart[RegionOrder[b]+1] - RegionStart[RegionOrder[b]];
+	return sizeB - sizeA;
+}
+
+double SolveRegions() {
+	printf("Now solving the %d regions in parallel...\n", NonEmptyRegions);
+	int BySize[REGIONS];
+	for (int k=0; k<NonEmptyRegions; k++) BySize[k] = k;
+	qsort(BySize, NonEmptyRegions, sizeof(int), CompareRegionSizes);
+
+	double totDist = 0.0;
+	#pragma omp parallel num_threads(THREADS)
+	#pragma omp single
+	{
+		for (int i=0; i<NonEmptyRegions; i++) {
+			int k = BySize[i];
+			#pragma omp task firstprivate(k)
+			{
+				double regionDist = SolveRegion(RegionOrder[k], RegionOffset[k], &Streams[RegionOrder[k]]);
+				#pragma omp atomic
+				totDist += regionDist;
+			}
+		}
+		#pragma omp taskwait
+	}
+
+	Path[N] = Path[0];
+	for (int k=0; k<NonEmptyRegions; k++) //The edges between the regions
+		totDist += Distance(RegionExit[RegionOrder[k]], RegionEntry[RegionOrder[(k+1) % NonEmptyRegions]]);
+	return totDist;
+}
+
+
+// ****************************************************************************************************************
+// The next and previous cities of a city in the path
+// ****************************************************************************************************************
+static inline int Next(int city) { return Path[PositionOfCity[city]+1]; }
+static inline int Prev(int city) { int i = PositionOfCity[city]; return Path[(i>0) ? i-1 : N-1]; }
+
+
+// ****************************************************************************************************************
+// Reverses the part of the path from position <i> to position <j> (both included, wrapping around the end of the path).
+// Reversing the rest of the path instead gives the same tour, so the shorter of the two parts is reversed
+// ****************************************************************************************************************
+void ReversePath(int i, int j) {
+	int length = (j - i + N) % N + 1;
+	if (2*length > N) { int temp = i; i = (j+1) % N; j = (temp-1+N) % N; length = N - length; }
+	for (int s=0; s<length/2; s++) {
+		int A = Path[i], B = Path[j];
+		Path[i] = B; PositionOfCity[B] = i;
+		Path[j] = A; PositionOfCity[A] = j;
+		i = (i+1 < N) ? i+1 : 0;
+		j = (j > 0) ? j-1 : N-1;
+	}
+	Path[N] = Path[0];
+}
+
+
+// ****************************************************************************************************************
+// Queue of the cities whose don't-look bit is off (<InQueue>)
+// ****************************************************************************************************************
+int Queue[N], QueueHead = 0, QueueSize = 0;
+bool InQueue[N];
+
+void Push(int city) {
+	if (InQueue[city]) return;
+	Queue[(QueueHead + QueueSize++) % N] = city; InQueue[city] = true;
+}
+
+int Pop() {
+	int city = Queue[QueueHead]; QueueHead = (QueueHead+1) % N; QueueSize--;
+	InQueue[city] = false;
+	return city;
+}
+
+
+// ****************************************************************************************************************
+// Repairs the stitches of the path in parallel: stitch s joins the regions s and s+1 of the path order, and its window
+// is the part of <Path> of both regions, improved by TwoOptInRange(). The windows of the even stitches never overlap,
+// and neither do the ones of the odd stitches, so the even stitches are repaired in parallel and then the odd ones.
+// The stitch of the last and the first region is left to RepairBorders(). Returns the total change of the path distance
+// ****************************************************************************************************************
+double RepairStitches() {
+	printf("Now repairing the stitches of the regions in parallel (2-opt)...\n");
+	double totDistChange = 0.0;
+	for (int parity=0; parity<2; parity++) {
+		#pragma omp parallel for schedule(dynamic, 1) reduction(+:totDistChange) num_threads(THREADS)
+		for (int s=parity; s<NonEmptyRegions-1; s+=2) {
+			int first = RegionOffset[s], last = (s+2 < NonEmptyRegions) ? RegionOffset[s+2]-1 : N-1;
+			int *WindowQueue = malloc(sizeof(int) * (last-first+1));
+			totDistChange += TwoOptInRange(first, last, RegionOrder[s], RegionOrder[s+1], WindowQueue);
+			free(WindowQueue);
+		}
+	}
+	printf("> Stitches repaired: %d ===> Completed.\n", (NonEmptyRegions > 1) ? NonEmptyRegions-1 : 0);
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// Repairs the stitched path with 2-opt moves over the whole path (as in tsp_opt01), starting only from the cities that
+// have a candidate in a region that is not next to their own in the path order (the others were repaired by
+// RepairStitches()). Returns the total change of the path distance
+// ****************************************************************************************************************
+double RepairBorders() {
+	printf("Now repairing the borders of the regions (2-opt)...\n");
+	double totDistChange = 0.0;
+	long long moves = 0;
+	int borderCities = 0, RankOfRegion[REGIONS];
+	for (int k=0; k<NonEmptyRegions; k++) RankOfRegion[RegionOrder[k]] = k;
+	for (int c=0; c<N; c++) {
+		for (int k=0; k<NEIGHBORS; k++)
+			if (abs(RankOfRegion[RegionOfCity[Neighbors[c][k]]] - RankOfRegion[RegionOfCity[c]]) > 1) { Push(c); borderCities ++; break; }
+	}
+	printf("> Cities at the borders of regions that are not consecutive: %d\n", borderCities);
+
+	while (QueueSize > 0) {
+		int A = Pop();
+		bool improved = false;
+		for (int direction=0; direction<2 && !improved; direction++) { // 0: A-B is followed by the path, 1: B-A
+			int B = (direction==0) ? Next(A) : Prev(A);
+			double dist1_old = Distance(A, B);
+			for (int k=0; k<NEIGHBORS; k++) {
+				int C = Neighbors[A][k];
+				double dist1_new = NeighborDistances[A][k];
+				if (dist1_new >= dist1_old) break; //The candidates are sorted, so no other move can shorten the path
+				int D = (direction==0) ? Next(C) : Prev(C);
+				if (C == B || D == A) continue;
+				double dist2_old = Distance(C, D);
+				double dist2_new = Distance(B, D);
+				double distChange = - dist1_old - dist2_old + dist1_new + dist2_new;
+				if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+					if (direction==0) ReversePath(PositionOfCity[B], PositionOfCity[C]); // A B ... C D -> A C ... B D
+					else ReversePath(PositionOfCity[A], PositionOfCity[D]);               // B A ... D C -> B D ... A C
+					Push(A); Push(B); Push(C); Push(D);
+					totDistChange += distChange; moves ++;
+					improved = true;
+					break;
+				}
+			}
+		}
+	}
+	printf("> Moves applied: %lld ===> Completed.\n", moves);
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// Returns 1 if <Path> visits every city exactly once and returns to the first one
+// ****************************************************************************************************************
+int ValidatePath() {
+	bool *Seen = calloc(N, sizeof(bool));
+	for (int i=0; i<N; i++) {
+		if (Path[i] < 0 || Path[i] >= N || Seen[Path[i]]) { free(Seen); return 0; }
+		Seen[Path[i]] = true;
+	}
+	free(Seen);
+	return (Path[N] == Path[0]);
+}
+
+
+// ****************************************************************************************************************
+// The main program
+// ****************************************************************************************************************
+int main( int argc, const char* argv[] ) {
+	printf("------------------------------------------------------------------------------\n");
+	printf("This program searches for the optimal traveling distance between %d cities,\n", N);
+	printf("spanning in an area of X=(0,%d) and Y=(0,%d)\n", Nx, Ny);
+	printf("------------------------------------------------------------------------------\n");
+
+	srand(1046900);
+	RngStreams(Streams, REGIONS, 1046900);
+	SetCities();
+	double start = omp_get_wtime(), phase = start;
+	BuildCandidateLists();
+	printf("> Time: %.3lf seconds\n", omp_get_wtime() - phase); phase = omp_get_wtime();
+	SplitInRegions();
+	OrderRegions();
+	SetPortals();
+	printf("> Non-empty regions: %d  Time: %.3lf seconds\n", NonEmptyRegions, omp_get_wtime() - phase); phase = omp_get_wtime();
+
+	double totDist = SolveRegions();
+	printf("> Stitched path length: %.2lf  Time: %.3lf seconds\n", totDist, omp_get_wtime() - phase); phase = omp_get_wtime();
+	totDist += RepairStitches();
+	printf("> Path length: %.2lf  Time: %.3lf seconds\n", totDist, omp_get_wtime() - phase); phase = omp_get_wtime();
+	totDist += RepairBorders();
+	printf("> Repaired path length: %.2lf  Time: %.3lf seconds\n", totDist, omp_get_wtime() - phase);
+
+	if (ValidatePath() == 0) { printf("\nERROR: THE PATH DOES NOT VISIT EVERY CITY EXACTLY ONCE\n"); return 1; }
+	printf("\nCalculations completed. Results:\n");
+	printf("Estimation of the optimal path length: %.2lf\n", totDist);
+	printf("Actual optimal path length: %.2lf\n", PathDistance_2(Path));
+	printf("Time: %.3lf seconds\n", omp_get_wtime() - start);
+	return 0 ;
+}
@@ -0,0 +1,97 @@
+/*
+Description:
+    Candidate lists shared by the "Travelling Salesman Problem" programs (#include "tsp_knn.h", after "stdio.h",
+    "stdlib.h" and "math.h"): the nearest cities of every city, found with a uniform grid instead of a scan of all cities
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+
+Version Notes:
+    --> KnnBuild() buckets the cities in the cells of a grid over the area (~<citiesPerCell> cities per cell, counting sort)
+        and searches rings of cells around every city in parallel, until the nearest cities found so far are closer than
+        any unsearched cell: O(N*NEIGHBORS) instead of O(N^2)
+    --> The lists are given as flat arrays (<count>*<neighbors> elements, row c holds the cities of city c, closest first),
+        so &Neighbors[0][0] of a program's [N][NEIGHBORS] array can be passed directly
+    --> The distances of the candidates are returned as floats (square roots of the float squared distances) when an array
+        is given for them. Programs that compare them against their Distance() fill their own arrays from Distance()
+    --> Was copied into every hh, ant, opt and cluster program since tsp_hh07; they now all include this header
+*/
+#ifndef TSP_KNN_H
+#define TSP_KNN_H
+
+
+// ****************************************************************************************************************
+// Builds the lists of the <neighbors> nearest cities (closest first) of the <count> cities at <X>, <Y> in the
+// <width>*<height> area into <Neighbors>, and their distances into <Distances> unless it is NULL
+// ****************************************************************************************************************
+static void KnnBuild(int count, int neighbors, const float X[], const float Y[], float width, float height,
+                     int citiesPerCell, int *Neighbors, float *Distances) {
+	printf("Now building the candidate lists of the %d nearest cities...\n", neighbors);
+	int gridSide = (int) ceil(sqrt(count / (double) citiesPerCell)), cells = gridSide*gridSide;
+	float cellWidth = width / (float) gridSide, cellHeight = height / (float) gridSide;
+	int *CityCell = malloc(sizeof(int) * count), *CellStart = calloc(cells+1, sizeof(int)), *CellCities = malloc(sizeof(int) * count);
+
+	// Bucket the cities by cell (counting sort)
+	#pragma omp parallel for schedule(static)
+	for (int c=0; c<count; c++) {
+		int gx = (int)(X[c] / cellWidth), gy = (int)(Y[c] / cellHeight);
+		gx = (gx < gridSide) ? gx : gridSide-1; gy = (gy < gridSide) ? gy : gridSide-1;
+		CityCell[c] = gy*gridSide + gx;
+	}
+	for (int c=0; c<count; c++) CellStart[CityCell[c]+1] ++;
+	for (int g=0; g<cells; g++) CellStart[g+1] += CellStart[g];
+	int *Fill = malloc(sizeof(int) * cells);
+	for (int g=0; g<cells; g++) Fill[g] = CellStart[g];
+	for (int c=0; c<count; c++) CellCities[Fill[CityCell[c]]++] = c;
+	free(Fill);
+
+	// Search rings of cells around each city until the nearest cities found so far are closer than any unsearched cell
+	int wanted = (neighbors < count-1) ? neighbors : count-1;
+	#pragma omp parallel for schedule(dynamic, 256)
+	for (int c=0; c<count; c++) {
+		float BestDist[neighbors];
+		int *List = &Neighbors[(long long)c*neighbors];
+		int found = 0, cx = CityCell[c] % gridSide, cy = CityCell[c] / gridSide;
+		for (int r=0; r<=gridSide; r++) {
+			for (int gy=cy-r; gy<=cy+r; gy++) {
+				if (gy < 0 || gy >= gridSide) continue;
+				for (int gx=cx-r; gx<=cx+r; gx++) {
+					if (gx < 0 || gx >= gridSide) continue;
+					if (abs(gx-cx) != r && abs(gy-cy) != r) continue; // Inner cells were searched in previous rings
+					int g = gy*gridSide + gx;
+					for (int k=CellStart[g]; k<CellStart[g+1]; k++) {
+						int city = CellCities[k];
+						if (city == c) continue;
+						float dx = X[c]-X[city], dy = Y[c]-Y[city], dist = dx*dx + dy*dy;
+						if (found == wanted && dist >= BestDist[found-1]) continue;
+						int pos = (found < wanted) ? found++ : found-1; // Insertion into the sorted list
+						while (pos > 0 && BestDist[pos-1] > dist) {
+							BestDist[pos] = BestDist[pos-1]; List[pos] = List[pos-1]; pos--;
+						}
+						BestDist[pos] = dist; List[pos] = city;
+					}
+				}
+			}
+			if (found == wanted) {
+				// Distance to the nearest side of the searched square that is not on the border of the grid
+				float margin = INFINITY;
+				if (cx-r > 0) margin = fminf(margin, X[c] - (cx-r)*cellWidth);
+				if (cx+r < gridSide-1) margin = fminf(margin, (cx+r+1)*cellWidth - X[c]);
+				if (cy-r > 0) margin = fminf(margin, Y[c] - (cy-r)*cellHeight);
+				if (cy+r < gridSide-1) margin = fminf(margin, (cy+r+1)*cellHeight - Y[c]);
+				if (margin*margin >= BestDist[found-1]) break; // Every unsearched city is farther than the last candidate
+			}
+		}
+		for (int k=found; k<neighbors; k++) { List[k] = List[found-1]; BestDist[k] = BestDist[found-1]; } // Only when count-1 < neighbors
+		if (Distances != NULL)
+			for (int k=0; k<neighbors; k++) Distances[(long long)c*neighbors + k] = sqrtf(BestDist[k]);
+	}
+	free(CityCell); free(CellStart); free(CellCities);
+	printf("> Grid of %dx%d cells ===> Completed.\n", gridSide, gridSide);
+}
+
+
+#endif
@@ -0,0 +1,320 @@
+/*
+Description:
+    This program improves a "Travelling Salesman Problem" path with my implementation of the "2-opt" local search
+	The starting path is random, a nearest neighbor ("Heinritz Hsiao") path or a path read from a file, so the output of
+	any other program can be improved
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles/Runs/Debugs with: gcc tsp_opt01.c -o tsp_opt01 -lm -O3 -fopt-info -fopenmp -pg && time ./tsp_opt01 [path_file] && gprof ./tsp_opt01
+    Executes the algorithm for 10.000 cities, spanning in an area of 1.000x1.000 km (same cities as tsp_rnd07 and tsp_hh06)
+    --> The starting path is selected with <CONSTRUCTION>: 0 = random path, 1 = nearest neighbor path. If a file is given as the
+        first argument, the path is read from it instead (the N city indices 0..N-1 in visiting order, separated by whitespace;
+        a closing repetition of the first city is ignored)
+    --> BuildCandidateLists() (same as tsp_hh08) finds the <NEIGHBORS> nearest cities of every city in parallel
+    --> TwoOpt() removes two edges of the path and reconnects it the other way, as long as this shortens the path. For every city
+        only the edges towards its candidate cities are tried, and the search stops as soon as the new edge is longer than the
+        removed one (no gain is possible after that)
+    --> Don't-look bits: only the cities kept in a queue are examined. A city leaves the queue when no improving move is found
+        around it and re-enters it when one of its edges changes, so the search ends when the queue is empty
+    --> The path is kept in <Path> together with the position of every city (<PositionOfCity>), so the neighbors of a city in
+        the path are found in O(1). The shorter of the two sides of the path is reversed on every move
+    --> With <WRITE_PATH> = 1 the final path is written to <PATH_OUTPUT_FILE>, in the format that is read
+*/
+
+
+// **************************************************************************************************************** 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// **************************************************************************************************************** 
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "omp.h"
+#include "stdbool.h"
+#include "tsp_knn.h"
+
+
+// ****************************************************************************************************************
+#define N  10000
+#define Nx 1000
+#define Ny 1000
+#define CONSTRUCTION 0    // 0: random path, 1: nearest neighbor path (ignored when a path file is given)
+#define NEIGHBORS 10      // Candidate cities per city
+#define CITIES_PER_CELL 2 // Average cities per cell of the grid of BuildCandidateLists()
+#define MIN_GAIN 1e-7     // Moves that shorten the path by less than this are ignored (rounding errors)
+#define WRITE_PATH 0
+#define PATH_OUTPUT_FILE "tsp_opt01_path.txt"
+
+
+// ****************************************************************************************************************
+float CitiesX[N];
+float CitiesY[N];
+int Path[N+1];         // Path[N] is always equal to Path[0]
+int PositionOfCity[N]; // Path[PositionOfCity[c]] == c
+int Neighbors[N][NEIGHBORS]; // The nearest cities of each city, closest first
+double NeighborDistances[N][NEIGHBORS]; // The distances of the cities in <Neighbors>, as given by Distance()
+
+
+// ****************************************************************************************************************
+// Initializes the cities' positions
+// ****************************************************************************************************************
+void SetCities() {
+	printf("Now initializing the positions of the cities...\n");
+	for (int i=0; i<N; i++) {
+		CitiesX[i] = Nx * (float) rand() / RAND_MAX;
+		CitiesY[i] = Ny * (float) rand() / RAND_MAX;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean distance between two cities
+// ****************************************************************************************************************
+double Distance(int A, int B) {
+	return (double) sqrt(   (CitiesX[A]-CitiesX[B])*(CitiesX[A]-CitiesX[B]) + (CitiesY[A]-CitiesY[B])*(CitiesY[A]-CitiesY[B])   );
+}
+
+
+// ****************************************************************************************************************
+// Finds Eucleidian distance in the current path
+// ****************************************************************************************************************
+double PathDistance() {
+	double totDist = 0.0;
+	#pragma omp parallel for reduction(+:totDist)
+	for (int i=0; i<N; i++) {
+		totDist += Distance(Path[i], Path[i+1]);
+	}
+	return totDist;
+}
+
+
+// ****************************************************************************************************************
+// Fills <PositionOfCity> and closes the path. Returns 0 if the path does not visit every city exactly once
+// ****************************************************************************************************************
+int IndexPath() {
+	for (int c=0; c<N; c++) PositionOfCity[c] = -1;
+	for (int i=0; i<N; i++) {
+		if (Path[i] < 0 || Path[i] >= N || PositionOfCity[Path[i]] >= 0) return 0;
+		PositionOfCity[Path[i]] = i;
+	}
+	Path[N] = Path[0];
+	return 1;
+}
+
+
+// ****************************************************************************************************************
+// Creates a random path (Fisher-Yates shuffle)
+// ****************************************************************************************************************
+void RandomizePath() {
+	printf("Now randomizing the path...\n");
+	for (int i=0; i<N; i++) Path[i] = i;
+	for (int i=N-1; i>0; i--) {
+		int k = (int)((i+1) * (rand() / (RAND_MAX+1.0)));
+		int temp = Path[i]; Path[i] = Path[k]; Path[k] = temp;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Reads the path from a file. Returns 0 if it cannot be read or is not a valid path
+// ****************************************************************************************************************
+int ReadPath(const char *filename) {
+	printf("Now reading the path from \"%s\"...\n", filename);
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) return 0;
+	int i = 0;
+	while (i < N && fscanf(file, "%d", &Path[i]) == 1) i++;
+	fclose(file);
+	return (i == N) && IndexPath();
+}
+
+
+// ****************************************************************************************************************
+// Writes the path to a file, one city per line
+// ****************************************************************************************************************
+void WritePath(const char *filename) {
+	printf("Now writing the path to \"%s\"...\n", filename);
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) { printf("> ERROR: Cannot open the file.\n"); return; }
+	for (int i=0; i<N; i++) fprintf(file, "%d\n", Path[i]);
+	fclose(file);
+}
+
+
+// ****************************************************************************************************************
+// Builds the lists of the <NEIGHBORS> nearest cities of every city (closest first) with the grid of "tsp_knn.h", and
+// their distances as given by Distance()
+// ****************************************************************************************************************
+void BuildCandidateLists() {
+	KnnBuild(N, NEIGHBORS, CitiesX, CitiesY, Nx, Ny, CITIES_PER_CELL, &Neighbors[0][0], NULL);
+	#pragma omp parallel for schedule(static)
+	for (int c=0; c<N; c++)
+		for (int k=0; k<NEIGHBORS; k++) NeighborDistances[c][k] = Distance(c, Neighbors[c][k]); // The gains of the moves mix both
+}
+
+
+// ****************************************************************************************************************
+// Creates a path by always visiting the closest non-visited city, starting from city 0. The closest city is taken
+// from the candidate list of the current city; all cities are scanned (vectorized) only when every candidate is visited
+// ****************************************************************************************************************
+void NearestNeighborPath() {
+	printf("Now creating the nearest neighbor path...\n");
+	bool *CityIsVisited = malloc(sizeof(bool) * N); for (int i=0; i<N; i++) CityIsVisited[i] = false;
+	int current_city = 0;
+	Path[0] = current_city; CityIsVisited[current_city] = true;
+	for (int visited_cities=1; visited_cities<N; visited_cities++) {
+		int next_city = -1;
+		for (int k=0; k<NEIGHBORS && next_city<0; k++)
+			if (CityIsVisited[Neighbors[current_city][k]] == false) next_city = Neighbors[current_city][k];
+		if (next_city < 0) {
+			float x = CitiesX[current_city], y = CitiesY[current_city], min_dist = INFINITY;
+			#pragma omp simd reduction(min:min_dist)
+			for (int i=0; i<N; i++) {
+				float dx = CitiesX[i]-x, dy = CitiesY[i]-y;
+				min_dist = fminf(min_dist, CityIsVisited[i] ? INFINITY : dx*dx + dy*dy);
+			}
+			for (int i=0; i<N && next_city<0; i++) {
+				float dx = CitiesX[i]-x, dy = CitiesY[i]-y;
+				if (CityIsVisited[i] == false && dx*dx + dy*dy == min_dist) next_city = i;
+			}
+		}
+		Path[visited_cities] = next_city; CityIsVisited[next_city] = true;
+		current_city = next_city;
+	}
+	free(CityIsVisited);
+}
+
+
+// ****************************************************************************************************************
+// The next and previous cities of a city in the path
+// ****************************************************************************************************************
+static inline int Next(int city) { return Path[PositionOfCity[city]+1]; }
+static inline int Prev(int city) { int i = PositionOfCity[city]; return Path[(i>0) ? i-1 : N-1]; }
+
+
+// ****************************************************************************************************************
+// Reverses the part of the path from position <i> to position <j> (both included, wrapping around the end of the path).
+// Reversing the rest of the path instead gives the same tour, so the shorter of the two parts is reversed
+// ****************************************************************************************************************
+void ReversePath(int i, int j) {
+	int length = (j - i + N) % N + 1;
+	if (2*length > N) { int temp = i; i = (j+1) % N; j = (temp-1+N) % N; length = N - length; }
+	for (int s=0; s<length/2; s++) {
+		int A = Path[i], B = Path[j];
+		Path[i] = B; PositionOfCity[B] = i;
+		Path[j] = A; PositionOfCity[A] = j;
+		i = (i+1 < N) ? i+1 : 0;
+		j = (j > 0) ? j-1 : N-1;
+	}
+	Path[N] = Path[0];
+}
+
+
+// ****************************************************************************************************************
+// Queue of the cities whose don't-look bit is off (<InQueue>)
+// ****************************************************************************************************************
+int Queue[N], QueueHead = 0, QueueSize = 0;
+bool InQueue[N];
+
+void Push(int city) {
+	if (InQueue[city]) return;
+	Queue[(QueueHead + QueueSize++) % N] = city; InQueue[city] = true;
+}
+
+int Pop() {
+	int city = Queue[QueueHead]; QueueHead = (QueueHead+1) % N; QueueSize--;
+	InQueue[city] = false;
+	return city;
+}
+
+
+// ****************************************************************************************************************
+// Applies improving 2-opt moves until none is left and returns the total change of the path distance.
+// For the city A with path neighbor B (next or previous) and a candidate city C with path neighbor D (on the same side),
+// the edges A-B and C-D are replaced by A-C and B-D
+// ****************************************************************************************************************
+double TwoOpt() {
+	printf("Now running the 2-opt local search...\n");
+	double totDistChange = 0.0;
+	long long moves = 0, checks = 0;
+	for (int c=0; c<N; c++) { InQueue[c] = false; }
+	for (int i=0; i<N; i++) Push(Path[i]);
+
+	while (QueueSize > 0) {
+		int A = Pop();
+		bool improved = false;
+		for (int direction=0; direction<2 && !improved; direction++) { // 0: A-B is followed by the path, 1: B-A
+			int B = (direction==0) ? Next(A) : Prev(A);
+			double dist1_old = Distance(A, B);
+			for (int k=0; k<NEIGHBORS; k++) {
+				int C = Neighbors[A][k];
+				double dist1_new = NeighborDistances[A][k];
+				if (dist1_new >= dist1_old) break; //The candidates are sorted, so no other move can shorten the path
+				int D = (direction==0) ? Next(C) : Prev(C);
+				if (C == B || D == A) continue;
+				checks ++;
+				double dist2_old = Distance(C, D);
+				double dist2_new = Distance(B, D);
+				double distChange = - dist1_old - dist2_old + dist1_new + dist2_new;
+				if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+					if (direction==0) ReversePath(PositionOfCity[B], PositionOfCity[C]); // A B ... C D -> A C ... B D
+					else ReversePath(PositionOfCity[A], PositionOfCity[D]);               // B A ... D C -> B D ... A C
+					Push(A); Push(B); Push(C); Push(D);
+					totDistChange += distChange; moves ++;
+					improved = true;
+					break;
+				}
+			}
+		}
+	}
+	printf("> Moves applied: %lld  Moves checked: %lld ===> Completed.\n", moves, checks);
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// The main program
+// ****************************************************************************************************************
+int main( int argc, const char* argv[] ) {
+	printf("------------------------------------------------------------------------------\n");
+	printf("This program improves a traveling path between %d cities,\n", N);
+	printf("spanning in an area of X=(0,%d) and Y=(0,%d)\n", Nx, Ny);
+	printf("------------------------------------------------------------------------------\n");
+
+	srand(1046900);
+	SetCities();
+	double start = omp_get_wtime();
+	BuildCandidateLists();
+
+	if (argc > 1) {
+		if (ReadPath(argv[1]) == 0) { printf("\nERROR: \"%s\" IS NOT A VALID PATH OF %d CITIES\nThe program will now exit.\n", argv[1], N); return 1; }
+	} else {
+		if (CONSTRUCTION == 1) NearestNeighborPath();
+		else RandomizePath();
+		IndexPath();
+	}
+	double totDist = PathDistance();
+	printf("Starting path length: %.2lf\n", totDist);
+
+	totDist += TwoOpt();
+	printf("\nCalculations completed. Results:\n");
+	printf("Estimation of the optimal path length: %.2lf\n", totDist);
+	printf("Actual optimal path length: %.2lf\n", PathDistance());
+	printf("Time: %.3lf seconds\n", omp_get_wtime() - start);
+	if (WRITE_PATH) WritePath(PATH_OUTPUT_FILE);
+	return 0 ;
+}
@@ -0,0 +1,401 @@
+/*
+Description:
+    This program improves a "Travelling Salesman Problem" path with my implementation of the "2-opt" local search
+	The starting path is random, a nearest neighbor ("Heinritz Hsiao") path or a path read from a file, so the output of
+	any other program can be improved
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles/Runs/Debugs with: gcc tsp_opt02.c -o tsp_opt02 -lm -O3 -fopt-info -fopenmp -pg && time ./tsp_opt02 [path_file] && gprof ./tsp_opt02
+	Inherits all settings of the previous version unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> TryOrOptMove() moves a segment of 1 to <OR_OPT_MAX_SEGMENT> consecutive cities (starting at the examined city) between
+        two other consecutive cities, keeping or reversing its direction. Only the places next to the candidate cities of the
+        segment's ends are tried. The change of the distance is calculated from the 3 removed and 3 added edges
+        (dist1_old ... dist3_new), without changing the path
+    --> The accepted Or-opt move is applied as 2 or 3 consecutive 2-opt moves (Make2OptMove()), so reversing the shorter
+        side of the path is kept
+    --> <LOCAL_SEARCH> selects the local search phase: 0 = 2-opt only, 1 = Or-opt only, 2 = both operators on every city
+    --> LocalSearch() prints the number of applied moves, checked moves and the total distance gain of each operator
+*/
+
+
+// **************************************************************************************************************** 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// **************************************************************************************************************** 
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "omp.h"
+#include "stdbool.h"
+#include "tsp_knn.h"
+
+
+// ****************************************************************************************************************
+#define N  10000
+#define Nx 1000
+#define Ny 1000
+#define CONSTRUCTION 0      // 0: random path, 1: nearest neighbor path (ignored when a path file is given)
+#define NEIGHBORS 10        // Candidate cities per city
+#define CITIES_PER_CELL 2   // Average cities per cell of the grid of BuildCandidateLists()
+#define MIN_GAIN 1e-7       // Moves that shorten the path by less than this are ignored (rounding errors)
+#define LOCAL_SEARCH 2     // 0: 2-opt, 1: Or-opt, 2: 2-opt and Or-opt
+#define OR_OPT_MAX_SEGMENT 3 // Maximum number of cities moved by an Or-opt move
+#define WRITE_PATH 0
+#define PATH_OUTPUT_FILE "tsp_opt02_path.txt"
+
+
+// ****************************************************************************************************************
+float CitiesX[N];
+float CitiesY[N];
+int Path[N+1];         // Path[N] is always equal to Path[0]
+int PositionOfCity[N]; // Path[PositionOfCity[c]] == c
+int Neighbors[N][NEIGHBORS]; // The nearest cities of each city, closest first
+double NeighborDistances[N][NEIGHBORS]; // The distances of the cities in <Neighbors>, as given by Distance()
+
+
+// ****************************************************************************************************************
+// Initializes the cities' positions
+// ****************************************************************************************************************
+void SetCities() {
+	printf("Now initializing the positions of the cities...\n");
+	for (int i=0; i<N; i++) {
+		CitiesX[i] = Nx * (float) rand() / RAND_MAX;
+		CitiesY[i] = Ny * (float) rand() / RAND_MAX;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean distance between two cities
+// ****************************************************************************************************************
+double Distance(int A, int B) {
+	return (double) sqrt(   (CitiesX[A]-CitiesX[B])*(CitiesX[A]-CitiesX[B]) + (CitiesY[A]-CitiesY[B])*(CitiesY[A]-CitiesY[B])   );
+}
+
+
+// ****************************************************************************************************************
+// Finds Eucleidian distance in the current path
+// ****************************************************************************************************************
+double PathDistance() {
+	double totDist = 0.0;
+	#pragma omp parallel for reduction(+:totDist)
+	for (int i=0; i<N; i++) {
+		totDist += Distance(Path[i], Path[i+1]);
+	}
+	return totDist;
+}
+
+
+// ****************************************************************************************************************
+// Fills <PositionOfCity> and closes the path. Returns 0 if the path does not visit every city exactly once
+// ****************************************************************************************************************
+int IndexPath() {
+	for (int c=0; c<N; c++) PositionOfCity[c] = -1;
+	for (int i=0; i<N; i++) {
+		if (Path[i] < 0 || Path[i] >= N || PositionOfCity[Path[i]] >= 0) return 0;
+		PositionOfCity[Path[i]] = i;
+	}
+	Path[N] = Path[0];
+	return 1;
+}
+
+
+// ****************************************************************************************************************
+// Creates a random path (Fisher-Yates shuffle)
+// ****************************************************************************************************************
+void RandomizePath() {
+	printf("Now randomizing the path...\n");
+	for (int i=0; i<N; i++) Path[i] = i;
+	for (int i=N-1; i>0; i--) {
+		int k = (int)((i+1) * (rand() / (RAND_MAX+1.0)));
+		int temp = Path[i]; Path[i] = Path[k]; Path[k] = temp;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Reads the path from a file. Returns 0 if it cannot be read or is not a valid path
+// ****************************************************************************************************************
+int ReadPath(const char *filename) {
+	printf("Now reading the path from \"%s\"...\n", filename);
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) return 0;
+	int i = 0;
+	while (i < N && fscanf(file, "%d", &Path[i]) == 1) i++;
+	fclose(file);
+	return (i == N) && IndexPath();
+}
+
+
+// ****************************************************************************************************************
+// Writes the path to a file, one city per line
+// ****************************************************************************************************************
+void WritePath(const char *filename) {
+	printf("Now writing the path to \"%s\"...\n", filename);
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) { printf("> ERROR: Cannot open the file.\n"); return; }
+	for (int i=0; i<N; i++) fprintf(file, "%d\n", Path[i]);
+	fclose(file);
+}
+
+
+// ****************************************************************************************************************
+// Builds the lists of the <NEIGHBORS> nearest cities of every city (closest first) with the grid of "tsp_knn.h", and
+// their distances as given by Distance()
+// ****************************************************************************************************************
+void BuildCandidateLists() {
+	KnnBuild(N, NEIGHBORS, CitiesX, CitiesY, Nx, Ny, CITIES_PER_CELL, &Neighbors[0][0], NULL);
+	#pragma omp parallel for schedule(static)
+	for (int c=0; c<N; c++)
+		for (int k=0; k<NEIGHBORS; k++) NeighborDistances[c][k] = Distance(c, Neighbors[c][k]); // The gains of the moves mix both
+}
+
+
+// ****************************************************************************************************************
+// Creates a path by always visiting the closest non-visited city, starting from city 0. The closest city is taken
+// from the candidate list of the current city; all cities are scanned (vectorized) only when every candidate is visited
+// ****************************************************************************************************************
+void NearestNeighborPath() {
+	printf("Now creating the nearest neighbor path...\n");
+	bool *CityIsVisited = malloc(sizeof(bool) * N); for (int i=0; i<N; i++) CityIsVisited[i] = false;
+	int current_city = 0;
+	Path[0] = current_city; CityIsVisited[current_city] = true;
+	for (int visited_cities=1; visited_cities<N; visited_cities++) {
+		int next_city = -1;
+		for (int k=0; k<NEIGHBORS && next_city<0; k++)
+			if (CityIsVisited[Neighbors[current_city][k]] == false) next_city = Neighbors[current_city][k];
+		if (next_city < 0) {
+			float x = CitiesX[current_city], y = CitiesY[current_city], min_dist = INFINITY;
+			#pragma omp simd reduction(min:min_dist)
+			for (int i=0; i<N; i++) {
+				float dx = CitiesX[i]-x, dy = CitiesY[i]-y;
+				min_dist = fminf(min_dist, CityIsVisited[i] ? INFINITY : dx*dx + dy*dy);
+			}
+			for (int i=0; i<N && next_city<0; i++) {
+				float dx = CitiesX[i]-x, dy = CitiesY[i]-y;
+				if (CityIsVisited[i] == false && dx*dx + dy*dy == min_dist) next_city = i;
+			}
+		}
+		Path[visited_cities] = next_city; CityIsVisited[next_city] = true;
+		current_city = next_city;
+	}
+	free(CityIsVisited);
+}
+
+
+// ****************************************************************************************************************
+// The next and previous cities of a city in the path
+// ****************************************************************************************************************
+static inline int Next(int city) { return Path[PositionOfCity[city]+1]; }
+static inline int Prev(int city) { int i = PositionOfCity[city]; return Path[(i>0) ? i-1 : N-1]; }
+
+
+// ****************************************************************************************************************
+// Reverses the part of the path from position <i> to position <j> (both included, wrapping around the end of the path).
+// Reversing the rest of the path instead gives the same tour, so the shorter of the two parts is reversed
+// ****************************************************************************************************************
+void ReversePath(int i, int j) {
+	int length = (j - i + N) % N + 1;
+	if (2*length > N) { int temp = i; i = (j+1) % N; j = (temp-1+N) % N; length = N - length; }
+	for (int s=0; s<length/2; s++) {
+		int A = Path[i], B = Path[j];
+		Path[i] = B; PositionOfCity[B] = i;
+		Path[j] = A; PositionOfCity[A] = j;
+		i = (i+1 < N) ? i+1 : 0;
+		j = (j > 0) ? j-1 : N-1;
+	}
+	Path[N] = Path[0];
+}
+
+
+// ****************************************************************************************************************
+// Queue of the cities whose don't-look bit is off (<InQueue>)
+// ****************************************************************************************************************
+int Queue[N], QueueHead = 0, QueueSize = 0;
+bool InQueue[N];
+
+void Push(int city) {
+	if (InQueue[city]) return;
+	Queue[(QueueHead + QueueSize++) % N] = city; InQueue[city] = true;
+}
+
+int Pop() {
+	int city = Queue[QueueHead]; QueueHead = (QueueHead+1) % N; QueueSize--;
+	InQueue[city] = false;
+	return city;
+}
+
+
+// ****************************************************************************************************************
+// Statistics of the local search operators
+// ****************************************************************************************************************
+#define OPERATORS 2
+const char *OperatorNames[OPERATORS] = {"2-opt", "Or-opt"};
+long long OperatorMoves[OPERATORS], OperatorChecks[OPERATORS];
+double OperatorGain[OPERATORS];
+
+
+// ****************************************************************************************************************
+// Replaces the edges T1-T2 and T3-T4 by T1-T3 and T2-T4. T2 must follow T1 in the path in the same direction that T4
+// follows T3 (both next or both previous cities)
+// ****************************************************************************************************************
+void Make2OptMove(int T1, int T2, int T3, int T4) {
+	if (Next(T1) == T2) ReversePath(PositionOfCity[T2], PositionOfCity[T3]); // T1 T2 ... T3 T4 -> T1 T3 ... T2 T4
+	else ReversePath(PositionOfCity[T1], PositionOfCity[T4]);               // T2 T1 ... T4 T3 -> T2 T4 ... T1 T3
+}
+
+
+// ****************************************************************************************************************
+// Tries the 2-opt moves around city A and applies the first one that shortens the path. Returns the change of the
+// path distance (0 if no move was applied). For the path neighbor B of A (next or previous) and a candidate city C with
+// path neighbor D (on the same side), the edges A-B and C-D are replaced by A-C and B-D
+// ****************************************************************************************************************
+double TryTwoOptMove(int A) {
+	for (int direction=0; direction<2; direction++) { // 0: A-B is followed by the path, 1: B-A
+		int B = (direction==0) ? Next(A) : Prev(A);
+		double dist1_old = Distance(A, B);
+		for (int k=0; k<NEIGHBORS; k++) {
+			int C = Neighbors[A][k];
+			double dist1_new = NeighborDistances[A][k];
+			if (dist1_new >= dist1_old) break; //The candidates are sorted, so no other move can shorten the path
+			int D = (direction==0) ? Next(C) : Prev(C);
+			if (C == B || D == A) continue;
+			OperatorChecks[0] ++;
+			double dist2_old = Distance(C, D);
+			double dist2_new = Distance(B, D);
+			double distChange = - dist1_old - dist2_old + dist1_new + dist2_new;
+			if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+				Make2OptMove(A, B, C, D);
+				Push(A); Push(B); Push(C); Push(D);
+				return distChange;
+			}
+		}
+	}
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// Tries to move the segment S1...S2 (from city A onwards, 1 to <OR_OPT_MAX_SEGMENT> cities) between the consecutive
+// cities U-V (V = Next(U)), next to a candidate city of S1 or S2, and applies the first move that shortens the path.
+// Returns the change of the path distance (0 if no move was applied). P-S1...S2-N and U-V become P-N and U-S1...S2-V
+// (or U-S2...S1-V when the segment is reversed)
+// ****************************************************************************************************************
+double TryOrOptMove(int A) {
+	int S1 = A, S2 = A;
+	for (int length=1; length<=OR_OPT_MAX_SEGMENT && length<N-2; length++, S2 = Next(S2)) {
+		int P = Prev(S1), NX = Next(S2);
+		double dist1_old = Distance(P, S1);
+		double dist2_old = Distance(S2, NX);
+		double dist1_new = Distance(P, NX);
+		double removalGain = dist1_old + dist2_old - dist1_new;
+		if (removalGain <= MIN_GAIN) continue;
+
+		for (int end=0; end<2; end++) { // The candidates of S1 and then of S2
+			int E = (end==0) ? S1 : S2;
+			for (int k=0; k<NEIGHBORS; k++) {
+				int C = Neighbors[E][k];
+				if (NeighborDistances[E][k] >= removalGain) break; //The candidates are sorted, so no other move can shorten the path
+				if ((PositionOfCity[C] - PositionOfCity[S1] + N) % N < length) continue; //C is in the segment
+				for (int side=0; side<2; side++) { // Between C and its next city, or its previous city and C
+					int U = (side==0) ? C : Prev(C), V = (side==0) ? Next(C) : C;
+					if ((PositionOfCity[U] - PositionOfCity[S1] + N) % N < length || (PositionOfCity[V] - PositionOfCity[S1] + N) % N < length) continue;
+					OperatorChecks[1] ++;
+					double dist3_old = Distance(U, V);
+					double dist2_new = Distance(U, S1) + Distance(S2, V); // U-S1...S2-V
+					double dist3_new = Distance(U, S2) + Distance(S1, V); // U-S2...S1-V
+					bool reversed = (dist3_new < dist2_new);
+					double distChange = - dist1_old - dist2_old - dist3_old + dist1_new + ((reversed) ? dist3_new : dist2_new);
+					if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+						if (U == NX) Make2OptMove(P, S1, NX, Next(NX));         // P S1...S2 N V -> P N S2...S1 V
+						else if (V == P) Make2OptMove(U, P, S2, NX);            // U P S1...S2 N -> U S2...S1 P N
+						else { Make2OptMove(P, S1, U, V); Make2OptMove(P, U, NX, S2); } // -> P U ... N S2...S1 V -> P N ... U S2...S1 V
+						if (!reversed && length > 1) Make2OptMove(U, S2, S1, V); // U S2...S1 V -> U S1...S2 V
+						Push(P); Push(NX); Push(S1); Push(S2); Push(U); Push(V);
+						return distChange;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// Applies the improving moves of the operators selected by <LOCAL_SEARCH> until none is left and returns the total
+// change of the path distance. Only the cities in the queue are examined (don't-look bits)
+// ****************************************************************************************************************
+double LocalSearch() {
+	printf("Now running the local search (%s)...\n", (LOCAL_SEARCH==0) ? "2-opt" : (LOCAL_SEARCH==1) ? "Or-opt" : "2-opt and Or-opt");
+	double totDistChange = 0.0;
+	for (int op=0; op<OPERATORS; op++) { OperatorMoves[op] = 0; OperatorChecks[op] = 0; OperatorGain[op] = 0; }
+	for (int c=0; c<N; c++) { InQueue[c] = false; }
+	for (int i=0; i<N; i++) Push(Path[i]);
+
+	while (QueueSize > 0) {
+		int A = Pop();
+		double distChange = 0;
+		if (LOCAL_SEARCH != 1) {
+			distChange = TryTwoOptMove(A);
+			if (distChange < 0) { OperatorMoves[0] ++; OperatorGain[0] -= distChange; totDistChange += distChange; continue; }
+		}
+		if (LOCAL_SEARCH != 0) {
+			distChange = TryOrOptMove(A);
+			if (distChange < 0) { OperatorMoves[1] ++; OperatorGain[1] -= distChange; totDistChange += distChange; }
+		}
+	}
+	for (int op=0; op<OPERATORS; op++)
+		printf("> %-7s Moves applied: %9lld  Moves checked: %11lld  Distance gain: %11.2lf\n", OperatorNames[op], OperatorMoves[op], OperatorChecks[op], OperatorGain[op]);
+	printf("> ===> Completed.\n");
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// The main program
+// ****************************************************************************************************************
+int main( int argc, const char* argv[] ) {
+	printf("------------------------------------------------------------------------------\n");
+	printf("This program improves a traveling path between %d cities,\n", N);
+	printf("spanning in an area of X=(0,%d) and Y=(0,%d)\n", Nx, Ny);
+	printf("------------------------------------------------------------------------------\n");
+
+	srand(1046900);
+	SetCities();
+	double start = omp_get_wtime();
+	BuildCandidateLists();
+
+	if (argc > 1) {
+		if (ReadPath(argv[1]) == 0) { printf("\nERROR: \"%s\" IS NOT A VALID PATH OF %d CITIES\nThe program will now exit.\n", argv[1], N); return 1; }
+	} else {
+		if (CONSTRUCTION == 1) NearestNeighborPath();
+		else RandomizePath();
+		IndexPath();
+	}
+	double totDist = PathDistance();
+	printf("Starting path length: %.2lf\n", totDist);
+
+	totDist += LocalSearch();
+	printf("\nCalculations completed. Results:\n");
+	printf("Estimation of the optimal path length: %.2lf\n", totDist);
+	printf("Actual optimal path length: %.2lf\n", PathDistance());
+	printf("Time: %.3lf seconds\n", omp_get_wtime() - start);
+	if (WRITE_PATH) WritePath(PATH_OUTPUT_FILE);
+	return 0 ;
+}
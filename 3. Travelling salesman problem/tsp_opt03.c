@@ -0,0 +1,587 @@
+/*
+Description:
+    This program improves "Travelling Salesman Problem" paths with my implementation of a "Lin-Kernighan" style local search
+	Every thread improves its own starting paths ("Heinritz Hsiao" paths from different starting cities) and the best
+	path of all is kept
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles/Runs/Debugs with: gcc tsp_opt03.c -o tsp_opt03 -lm -O3 -fopt-info -fopenmp -pg && time ./tsp_opt03 [path_file] && gprof ./tsp_opt03
+	Inherits all settings of the previous version unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> TryLKMove() builds a chain of up to <LK_MAX_DEPTH> 2-opt moves (a sequential 3-opt, 4-opt, ... move): the edge T1-T2 is
+        removed, the edge T2-T3 to a candidate city T3 is added and the edge T3-T4 is removed, so that the path closes with T1-T4.
+        The next move of the chain removes T1-T4 again. The chain goes on while the sum of the removed minus the added edges
+        (without the closing one) is positive; the moves after the best closed path of the chain are undone
+    --> Breadth of the search: <LK_BREADTH_1> candidates T3 are tried on the first move of the chain, <LK_BREADTH_2> on the
+        second and one on the deeper moves. The edges added by the chain are never removed again
+    --> IteratedLocalSearch(): after the local search, <KICKS> double-bridge kicks (two consecutive short segments exchanged)
+        are applied, each followed by the local search around it. A kick that does not shorten the path is undone by
+        replaying the journal of the reversals it caused (<Journal>) backwards
+    --> <LOCAL_SEARCH> = 3 (default) uses the chains and Or-opt
+    --> <STARTS> starting paths are improved, distributed dynamically to <THREADS> threads. Every thread has its own path,
+        city positions and don't-look queue (arrays indexed by the thread), so the threads never wait for each other
+    --> The starting paths are created by ConstructPath(): the closest or second closest non-visited city is visited (as in
+        tsp_hh08, with <PICK_CLOSEST_CITY_POSSIBILITY>), starting from a different city for every start. A path file given
+        as the first argument replaces the first starting path
+    --> The best path of all starts is kept in <BestPath>
+*/
+
+
+// **************************************************************************************************************** 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// **************************************************************************************************************** 
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "omp.h"
+#include "stdbool.h"
+#include "tsp_knn.h"
+
+
+// ****************************************************************************************************************
+#define N  10000
+#define Nx 1000
+#define Ny 1000
+#define THREADS 12
+#define STARTS THREADS       // Starting paths improved (multi-start)
+#define PICK_CLOSEST_CITY_POSSIBILITY 0.90
+#define NEIGHBORS 10         // Candidate cities per city
+#define CITIES_PER_CELL 2    // Average cities per cell of the grid of BuildCandidateLists()
+#define MIN_GAIN 1e-7        // Moves that shorten the path by less than this are ignored (rounding errors)
+#define LOCAL_SEARCH 3       // 0: 2-opt, 1: Or-opt, 2: 2-opt and Or-opt, 3: LK chains and Or-opt
+#define OR_OPT_MAX_SEGMENT 3 // Maximum number of cities moved by an Or-opt move
+#define LK_MAX_DEPTH 50      // Maximum number of 2-opt moves in a chain
+#define LK_BREADTH_1 10      // Candidates tried on the first move of a chain
+#define LK_BREADTH_2 5       // Candidates tried on the second move of a chain (one on the deeper moves)
+#define KICKS 10000          // Double-bridge kicks per starting path (0: plain local search)
+#define KICK_SEGMENT 50      // Maximum length of the segments exchanged by a kick
+#define JOURNAL_SIZE 4096    // Reversals that can be undone after a kick
+#define WRITE_PATH 0
+#define PATH_OUTPUT_FILE "tsp_opt03_path.txt"
+
+
+// ****************************************************************************************************************
+float CitiesX[N];
+float CitiesY[N];
+int ThreadsPath[THREADS][N+1];         // ThreadsPath[t][N] is always equal to ThreadsPath[t][0]
+int ThreadsPositionOfCity[THREADS][N]; // ThreadsPath[t][ThreadsPositionOfCity[t][c]] == c
+int BestPath[N+1];
+int Neighbors[N][NEIGHBORS]; // The nearest cities of each city, closest first
+double NeighborDistances[N][NEIGHBORS]; // The distances of the cities in <Neighbors>, as given by Distance()
+
+
+// ****************************************************************************************************************
+// Initializes the cities' positions
+// ****************************************************************************************************************
+void SetCities() {
+	printf("Now initializing the positions of the cities...\n");
+	for (int i=0; i<N; i++) {
+		CitiesX[i] = Nx * (float) rand() / RAND_MAX;
+		CitiesY[i] = Ny * (float) rand() / RAND_MAX;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean distance between two cities
+// ****************************************************************************************************************
+double Distance(int A, int B) {
+	return (double) sqrt(   (CitiesX[A]-CitiesX[B])*(CitiesX[A]-CitiesX[B]) + (CitiesY[A]-CitiesY[B])*(CitiesY[A]-CitiesY[B])   );
+}
+
+
+// ****************************************************************************************************************
+// Finds Eucleidian distance in a given path
+// ****************************************************************************************************************
+double PathDistance_2(int Path[]) {
+	double totDist = 0.0;
+	for (int i=0; i<N; i++) {
+		totDist += Distance(Path[i], Path[i+1]);
+	}
+	return totDist;
+}
+
+
+// ****************************************************************************************************************
+// Fills the city positions of thread <t> and closes its path. Returns 0 if the path does not visit every city exactly once
+// ****************************************************************************************************************
+int IndexPath(int t) {
+	int *Path = ThreadsPath[t], *PositionOfCity = ThreadsPositionOfCity[t];
+	for (int c=0; c<N; c++) PositionOfCity[c] = -1;
+	for (int i=0; i<N; i++) {
+		if (Path[i] < 0 || Path[i] >= N || PositionOfCity[Path[i]] >= 0) return 0;
+		PositionOfCity[Path[i]] = i;
+	}
+	Path[N] = Path[0];
+	return 1;
+}
+
+
+// ****************************************************************************************************************
+// Reads a path from a file into <Path>. Returns 0 if it cannot be read
+// ****************************************************************************************************************
+int ReadPath(const char *filename, int Path[]) {
+	printf("Now reading the path from \"%s\"...\n", filename);
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) return 0;
+	int i = 0;
+	while (i < N && fscanf(file, "%d", &Path[i]) == 1) i++;
+	fclose(file);
+	return (i == N);
+}
+
+
+// ****************************************************************************************************************
+// Writes a path to a file, one city per line
+// ****************************************************************************************************************
+void WritePath(const char *filename, int Path[]) {
+	printf("Now writing the path to \"%s\"...\n", filename);
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) { printf("> ERROR: Cannot open the file.\n"); return; }
+	for (int i=0; i<N; i++) fprintf(file, "%d\n", Path[i]);
+	fclose(file);
+}
+
+
+// ****************************************************************************************************************
+// Builds the lists of the <NEIGHBORS> nearest cities of every city (closest first) with the grid of "tsp_knn.h", and
+// their distances as given by Distance()
+// ****************************************************************************************************************
+void BuildCandidateLists() {
+	KnnBuild(N, NEIGHBORS, CitiesX, CitiesY, Nx, Ny, CITIES_PER_CELL, &Neighbors[0][0], NULL);
+	#pragma omp parallel for schedule(static)
+	for (int c=0; c<N; c++)
+		for (int k=0; k<NEIGHBORS; k++) NeighborDistances[c][k] = Distance(c, Neighbors[c][k]); // The gains of the moves mix both
+}
+
+
+// ****************************************************************************************************************
+// Finds the closest and second closest non-visited cities of <city> by scanning all cities. The squared distances are
+// calculated on the fly in vectorized loops and stored in <Buffer> (N floats), then both minimums are located
+// ****************************************************************************************************************
+void FindClosestCities(int city, const bool CityIsVisited[], float Buffer[], int *closest_city_1, double *min_dist_1, int *closest_city_2, double *min_dist_2) {
+	float x = CitiesX[city], y = CitiesY[city], min_1 = INFINITY, min_2 = INFINITY;
+	#pragma omp simd reduction(min:min_1)
+	for (int i=0; i<N; i++) {
+		float dx = CitiesX[i]-x, dy = CitiesY[i]-y;
+		Buffer[i] = CityIsVisited[i] ? INFINITY : dx*dx + dy*dy; //Visited cities (and <city> itself) are never picked
+		min_1 = fminf(min_1, Buffer[i]);
+	}
+	*closest_city_1 = -1; *closest_city_2 = -1; *min_dist_1 = INFINITY; *min_dist_2 = INFINITY;
+	if (min_1 == INFINITY) return;
+	for (int i=0; i<N; i++) if (Buffer[i] == min_1) { *closest_city_1 = i; break; }
+	Buffer[*closest_city_1] = INFINITY;
+	*min_dist_1 = sqrt(min_1);
+
+	#pragma omp simd reduction(min:min_2)
+	for (int i=0; i<N; i++) min_2 = fminf(min_2, Buffer[i]);
+	if (min_2 == INFINITY) return;
+	for (int i=0; i<N; i++) if (Buffer[i] == min_2) { *closest_city_2 = i; break; }
+	*min_dist_2 = sqrt(min_2);
+}
+
+
+// ****************************************************************************************************************
+// Creates the path of thread <t> starting from <start_city>, by visiting the closest or the second closest non-visited
+// city each time (the candidate lists are used while at least two candidates are non-visited)
+// ****************************************************************************************************************
+void ConstructPath(int t, int start_city, unsigned seed) {
+	int *Path = ThreadsPath[t];
+	bool *CityIsVisited = malloc(sizeof(bool) * N); for (int i=0; i<N; i++) CityIsVisited[i] = false;
+	float *ScanBuffer = malloc(sizeof(float) * N);
+	int current_city = start_city;
+	Path[0] = current_city; CityIsVisited[current_city] = true;
+	for (int visited_cities=1; visited_cities<N; visited_cities++) {
+		double min_dist_1, min_dist_2;
+		int closest_city_1 = -1, closest_city_2 = -1;
+		for (int k=0; k<NEIGHBORS && closest_city_2<0; k++) {
+			int i = Neighbors[current_city][k];
+			if (CityIsVisited[i] == true) continue;
+			if (closest_city_1 < 0) closest_city_1 = i;
+			else closest_city_2 = i;
+		}
+		if (closest_city_2 < 0)
+			FindClosestCities(current_city, CityIsVisited, ScanBuffer, &closest_city_1, &min_dist_1, &closest_city_2, &min_dist_2);
+		float random_number = ((float)rand_r(&seed)) / ((float)RAND_MAX);
+		int next_city = (random_number<PICK_CLOSEST_CITY_POSSIBILITY || closest_city_2<0) ? closest_city_1 : closest_city_2;
+		Path[visited_cities] = next_city; CityIsVisited[next_city] = true;
+		current_city = next_city;
+	}
+	free(CityIsVisited); free(ScanBuffer);
+	IndexPath(t);
+}
+
+
+// ****************************************************************************************************************
+// The next and previous cities of a city in the path of thread <t>
+// ****************************************************************************************************************
+static inline int Next(int t, int city) { return ThreadsPath[t][ThreadsPositionOfCity[t][city]+1]; }
+static inline int Prev(int t, int city) { int i = ThreadsPositionOfCity[t][city]; return ThreadsPath[t][(i>0) ? i-1 : N-1]; }
+
+
+// ****************************************************************************************************************
+// Reverses the part of the path of thread <t> from position <i> to position <j> (both included, wrapping around the end
+// of the path). Reversing the rest of the path instead gives the same tour, so the shorter of the two parts is reversed.
+// Calling it again with the same <i>, <j> undoes the reversal, so the reversals are recorded in the journal of the thread
+// while <Journaling> is on (a reversal that undoes the last recorded one removes it instead)
+// ****************************************************************************************************************
+int Journal[THREADS][JOURNAL_SIZE][2], JournalLength[THREADS];
+bool Journaling[THREADS];
+
+void ReversePath(int t, int i, int j) {
+	int *Path = ThreadsPath[t], *PositionOfCity = ThreadsPositionOfCity[t];
+	if (Journaling[t]) {
+		int last = JournalLength[t]-1;
+		if (last >= 0 && last < JOURNAL_SIZE && Journal[t][last][0] == i && Journal[t][last][1] == j) JournalLength[t] --; //Undoes the last reversal
+		else {
+			if (JournalLength[t] < JOURNAL_SIZE) { Journal[t][JournalLength[t]][0] = i; Journal[t][JournalLength[t]][1] = j; }
+			JournalLength[t] ++;
+		}
+	}
+	int length = (j - i + N) % N + 1;
+	if (2*length > N) { int temp = i; i = (j+1) % N; j = (temp-1+N) % N; length = N - length; }
+	for (int s=0; s<length/2; s++) {
+		int A = Path[i], B = Path[j];
+		Path[i] = B; PositionOfCity[B] = i;
+		Path[j] = A; PositionOfCity[A] = j;
+		i = (i+1 < N) ? i+1 : 0;
+		j = (j > 0) ? j-1 : N-1;
+	}
+	Path[N] = Path[0];
+}
+
+
+// ****************************************************************************************************************
+// Queues of the cities whose don't-look bit is off (<InQueue>), one per thread
+// ****************************************************************************************************************
+int Queue[THREADS][N], QueueHead[THREADS], QueueSize[THREADS];
+bool InQueue[THREADS][N];
+
+void Push(int t, int city) {
+	if (InQueue[t][city]) return;
+	Queue[t][(QueueHead[t] + QueueSize[t]++) % N] = city; InQueue[t][city] = true;
+}
+
+int Pop(int t) {
+	int city = Queue[t][QueueHead[t]]; QueueHead[t] = (QueueHead[t]+1) % N; QueueSize[t]--;
+	InQueue[t][city] = false;
+	return city;
+}
+
+
+// ****************************************************************************************************************
+// Statistics of the local search operators, per thread
+// ****************************************************************************************************************
+#define OPERATORS 3
+const char *OperatorNames[OPERATORS] = {"2-opt", "Or-opt", "LK"};
+long long OperatorMoves[THREADS][OPERATORS], OperatorChecks[THREADS][OPERATORS];
+double OperatorGain[THREADS][OPERATORS];
+long long KicksAccepted[THREADS];
+
+
+// ****************************************************************************************************************
+// Replaces the edges T1-T2 and T3-T4 by T1-T3 and T2-T4 in the path of thread <t>. T2 must follow T1 in the path in the
+// same direction that T4 follows T3 (both next or both previous cities). The reversed positions are stored in <Flip>
+// (if not NULL), so that the move can be undone
+// ****************************************************************************************************************
+void Make2OptMove(int t, int T1, int T2, int T3, int T4, int Flip[2]) {
+	int *PositionOfCity = ThreadsPositionOfCity[t];
+	int i = PositionOfCity[T2], j = PositionOfCity[T3];                   // T1 T2 ... T3 T4 -> T1 T3 ... T2 T4
+	if (Next(t, T1) != T2) { i = PositionOfCity[T1]; j = PositionOfCity[T4]; } // T2 T1 ... T4 T3 -> T2 T4 ... T1 T3
+	if (Flip != NULL) { Flip[0] = i; Flip[1] = j; }
+	ReversePath(t, i, j);
+}
+
+
+// ****************************************************************************************************************
+// Tries the 2-opt moves around city A and applies the first one that shortens the path. Returns the change of the
+// path distance (0 if no move was applied). For the path neighbor B of A (next or previous) and a candidate city C with
+// path neighbor D (on the same side), the edges A-B and C-D are replaced by A-C and B-D
+// ****************************************************************************************************************
+double TryTwoOptMove(int t, int A) {
+	for (int direction=0; direction<2; direction++) { // 0: A-B is followed by the path, 1: B-A
+		int B = (direction==0) ? Next(t, A) : Prev(t, A);
+		double dist1_old = Distance(A, B);
+		for (int k=0; k<NEIGHBORS; k++) {
+			int C = Neighbors[A][k];
+			double dist1_new = NeighborDistances[A][k];
+			if (dist1_new >= dist1_old) break; //The candidates are sorted, so no other move can shorten the path
+			int D = (direction==0) ? Next(t, C) : Prev(t, C);
+			if (C == B || D == A) continue;
+			OperatorChecks[t][0] ++;
+			double dist2_old = Distance(C, D);
+			double dist2_new = Distance(B, D);
+			double distChange = - dist1_old - dist2_old + dist1_new + dist2_new;
+			if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+				Make2OptMove(t, A, B, C, D, NULL);
+				Push(t, A); Push(t, B); Push(t, C); Push(t, D);
+				return distChange;
+			}
+		}
+	}
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// Tries to move the segment S1...S2 (from city A onwards, 1 to <OR_OPT_MAX_SEGMENT> cities) between the consecutive
+// cities U-V (V = Next(U)), next to a candidate city of S1 or S2, and applies the first move that shortens the path.
+// Returns the change of the path distance (0 if no move was applied). P-S1...S2-N and U-V become P-N and U-S1...S2-V
+// (or U-S2...S1-V when the segment is reversed)
+// ****************************************************************************************************************
+double TryOrOptMove(int t, int A) {
+	int *PositionOfCity = ThreadsPositionOfCity[t];
+	int S1 = A, S2 = A;
+	for (int length=1; length<=OR_OPT_MAX_SEGMENT && length<N-2; length++, S2 = Next(t, S2)) {
+		int P = Prev(t, S1), NX = Next(t, S2);
+		double dist1_old = Distance(P, S1);
+		double dist2_old = Distance(S2, NX);
+		double dist1_new = Distance(P, NX);
+		double removalGain = dist1_old + dist2_old - dist1_new;
+		if (removalGain <= MIN_GAIN) continue;
+
+		for (int end=0; end<2; end++) { // The candidates of S1 and then of S2
+			int E = (end==0) ? S1 : S2;
+			for (int k=0; k<NEIGHBORS; k++) {
+				int C = Neighbors[E][k];
+				if (NeighborDistances[E][k] >= removalGain) break; //The candidates are sorted, so no other move can shorten the path
+				if ((PositionOfCity[C] - PositionOfCity[S1] + N) % N < length) continue; //C is in the segment
+				for (int side=0; side<2; side++) { // Between C and its next city, or its previous city and C
+					int U = (side==0) ? C : Prev(t, C), V = (side==0) ? Next(t, C) : C;
+					if ((PositionOfCity[U] - PositionOfCity[S1] + N) % N < length || (PositionOfCity[V] - PositionOfCity[S1] + N) % N < length) continue;
+					OperatorChecks[t][1] ++;
+					double dist3_old = Distance(U, V);
+					double dist2_new = Distance(U, S1) + Distance(S2, V); // U-S1...S2-V
+					double dist3_new = Distance(U, S2) + Distance(S1, V); // U-S2...S1-V
+					bool reversed = (dist3_new < dist2_new);
+					double distChange = - dist1_old - dist2_old - dist3_old + dist1_new + ((reversed) ? dist3_new : dist2_new);
+					if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+						if (U == NX) Make2OptMove(t, P, S1, NX, Next(t, NX), NULL);         // P S1...S2 N V -> P N S2...S1 V
+						else if (V == P) Make2OptMove(t, U, P, S2, NX, NULL);               // U P S1...S2 N -> U S2...S1 P N
+						else { Make2OptMove(t, P, S1, U, V, NULL); Make2OptMove(t, P, U, NX, S2, NULL); } // -> P U ... N S2...S1 V -> P N ... U S2...S1 V
+						if (!reversed && length > 1) Make2OptMove(t, U, S2, S1, V, NULL); // U S2...S1 V -> U S1...S2 V
+						Push(t, P); Push(t, NX); Push(t, S1); Push(t, S2); Push(t, U); Push(t, V);
+						return distChange;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// State of the chain of TryLKMove(), per thread
+// ****************************************************************************************************************
+int ChainFlips[THREADS][LK_MAX_DEPTH][2];   // The reversed positions of every move of the chain
+int ChainCities[THREADS][LK_MAX_DEPTH][4];  // T1, T2, T3, T4 of every move of the chain
+double ChainBestGain[THREADS];
+int ChainBestDepth[THREADS];
+
+
+// ****************************************************************************************************************
+// Adds the move <depth> of the chain: T1-T2 is removed and T2-T3 is added for a candidate city T3 of T2, and T3-T4 is
+// removed so that the path closes with T1-T4. <gain> is the sum of the removed minus the added edges so far. Keeps the
+// moves up to the best closed path found by the chain (<ChainBestDepth>) and undoes the rest
+// ****************************************************************************************************************
+void ExtendChain(int t, int depth, int T1, int T2, double gain) {
+	int tried = 0;
+	for (int k=0; k<NEIGHBORS && tried<((depth==0) ? LK_BREADTH_1 : (depth==1) ? LK_BREADTH_2 : 1); k++) {
+		int T3 = Neighbors[T2][k];
+		double gain_1 = gain - NeighborDistances[T2][k];
+		if (gain_1 <= MIN_GAIN) break; //The candidates are sorted, so no other city can continue the chain
+		if (T3 == T1 || T3 == Next(t, T2) || T3 == Prev(t, T2)) continue;
+		int T4 = (Next(t, T1) == T2) ? Prev(t, T3) : Next(t, T3);
+		bool added = false; // T3-T4 must not be an edge added by the chain
+		for (int d=0; d<depth && !added; d++)
+			added = (ChainCities[t][d][1] == T3 && ChainCities[t][d][2] == T4) || (ChainCities[t][d][1] == T4 && ChainCities[t][d][2] == T3);
+		if (added) continue;
+		tried ++; OperatorChecks[t][2] ++;
+
+		double gain_2 = gain_1 + Distance(T3, T4);
+		Make2OptMove(t, T2, T1, T3, T4, ChainFlips[t][depth]); // T1 T2 ... T4 T3 -> T1 T4 ... T2 T3
+		ChainCities[t][depth][0] = T1; ChainCities[t][depth][1] = T2; ChainCities[t][depth][2] = T3; ChainCities[t][depth][3] = T4;
+		if (gain_2 - Distance(T4, T1) > ChainBestGain[t]) { ChainBestGain[t] = gain_2 - Distance(T4, T1); ChainBestDepth[t] = depth+1; }
+		if (depth+1 < LK_MAX_DEPTH) ExtendChain(t, depth+1, T1, T4, gain_2);
+		if (ChainBestGain[t] > MIN_GAIN) { // Keep the moves up to the best depth
+			if (depth+1 > ChainBestDepth[t]) ReversePath(t, ChainFlips[t][depth][0], ChainFlips[t][depth][1]);
+			return;
+		}
+		ReversePath(t, ChainFlips[t][depth][0], ChainFlips[t][depth][1]);
+	}
+}
+
+
+// ****************************************************************************************************************
+// Tries the chains of 2-opt moves that start by removing an edge of city A and applies the first one that shortens the
+// path. Returns the change of the path distance (0 if no chain was applied)
+// ****************************************************************************************************************
+double TryLKMove(int t, int A) {
+	for (int direction=0; direction<2; direction++) {
+		int B = (direction==0) ? Next(t, A) : Prev(t, A);
+		ChainBestGain[t] = 0; ChainBestDepth[t] = 0;
+		ExtendChain(t, 0, A, B, Distance(A, B));
+		if (ChainBestGain[t] > MIN_GAIN) {
+			for (int d=0; d<ChainBestDepth[t]; d++)
+				for (int c=0; c<4; c++) Push(t, ChainCities[t][d][c]);
+			return -ChainBestGain[t];
+		}
+	}
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// Puts every city of the path of thread <t> in its queue
+// ****************************************************************************************************************
+void ResetQueue(int t) {
+	for (int c=0; c<N; c++) { InQueue[t][c] = false; }
+	QueueHead[t] = 0; QueueSize[t] = 0;
+	for (int i=0; i<N; i++) Push(t, ThreadsPath[t][i]);
+}
+
+
+// ****************************************************************************************************************
+// Applies the improving moves of the operators selected by <LOCAL_SEARCH> to the path of thread <t> until none is left
+// and returns the total change of the path distance. Only the cities in the queue are examined (don't-look bits)
+// ****************************************************************************************************************
+double LocalSearch(int t) {
+	double totDistChange = 0.0;
+	while (QueueSize[t] > 0) {
+		int A = Pop(t);
+		double distChange = 0;
+		int op = (LOCAL_SEARCH == 3) ? 2 : 0;
+		if (LOCAL_SEARCH != 1) {
+			distChange = (op == 2) ? TryLKMove(t, A) : TryTwoOptMove(t, A);
+			if (distChange < 0) { OperatorMoves[t][op] ++; OperatorGain[t][op] -= distChange; totDistChange += distChange; continue; }
+		}
+		if (LOCAL_SEARCH != 0) {
+			distChange = TryOrOptMove(t, A);
+			if (distChange < 0) { OperatorMoves[t][1] ++; OperatorGain[t][1] -= distChange; totDistChange += distChange; }
+		}
+	}
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// Exchanges two consecutive random segments of the path of thread <t> (double-bridge kick): A B...B' C...C' D becomes
+// A C...C' B...B' D. The six cities around the segments are queued. Returns the change of the path distance
+// ****************************************************************************************************************
+double DoubleBridgeKick(int t, unsigned *seed) {
+	int *Path = ThreadsPath[t];
+	int maxSegment = (KICK_SEGMENT < N/8) ? KICK_SEGMENT : N/8;
+	int p = rand_r(seed) % N, L1 = 1 + rand_r(seed) % maxSegment, L2 = 1 + rand_r(seed) % maxSegment;
+	int A = Path[p], B1 = Path[(p+1) % N], B2 = Path[(p+L1) % N], C1 = Path[(p+L1+1) % N], C2 = Path[(p+L1+L2) % N], D = Path[(p+L1+L2+1) % N];
+	double dist1_old = Distance(A, B1);
+	double dist2_old = Distance(B2, C1);
+	double dist3_old = Distance(C2, D);
+	double dist1_new = Distance(A, C1);
+	double dist2_new = Distance(C2, B1);
+	double dist3_new = Distance(B2, D);
+	ReversePath(t, (p+1) % N, (p+L1) % N);       // A B'...B C...C' D
+	ReversePath(t, (p+L1+1) % N, (p+L1+L2) % N); // A B'...B C'...C D
+	ReversePath(t, (p+1) % N, (p+L1+L2) % N);    // A C...C' B...B' D
+	Push(t, A); Push(t, B1); Push(t, B2); Push(t, C1); Push(t, C2); Push(t, D);
+	return - dist1_old - dist2_old - dist3_old + dist1_new + dist2_new + dist3_new;
+}
+
+
+// ****************************************************************************************************************
+// Improves the path of thread <t> with the local search and then with <KICKS> kicks: every kick is followed by the local
+// search around it and is undone (from the journal of reversals) if the path did not become shorter. Returns the total
+// change of the path distance
+// ****************************************************************************************************************
+double IteratedLocalSearch(int t, unsigned seed) {
+	ResetQueue(t);
+	double totDistChange = LocalSearch(t);
+	if (N < 8) return totDistChange;
+	for (int kick=0; kick<KICKS; kick++) {
+		long long SavedMoves[OPERATORS]; double SavedGain[OPERATORS];
+		for (int op=0; op<OPERATORS; op++) { SavedMoves[op] = OperatorMoves[t][op]; SavedGain[op] = OperatorGain[t][op]; }
+		JournalLength[t] = 0; Journaling[t] = true;
+		double distChange = DoubleBridgeKick(t, &seed);
+		distChange += LocalSearch(t);
+		Journaling[t] = false;
+		if (distChange < -MIN_GAIN || JournalLength[t] > JOURNAL_SIZE) { //Kept (also when the journal overflowed and it cannot be undone)
+			totDistChange += distChange; KicksAccepted[t] ++;
+		} else {
+			for (int k=JournalLength[t]-1; k>=0; k--) ReversePath(t, Journal[t][k][0], Journal[t][k][1]);
+			for (int op=0; op<OPERATORS; op++) { OperatorMoves[t][op] = SavedMoves[op]; OperatorGain[t][op] = SavedGain[op]; }
+		}
+	}
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// The main program
+// ****************************************************************************************************************
+int main( int argc, const char* argv[] ) {
+	printf("------------------------------------------------------------------------------\n");
+	printf("This program searches for the optimal traveling distance between %d cities,\n", N);
+	printf("spanning in an area of X=(0,%d) and Y=(0,%d)\n", Nx, Ny);
+	printf("------------------------------------------------------------------------------\n");
+
+	srand(1046900);
+	SetCities();
+	double start = omp_get_wtime();
+	BuildCandidateLists();
+
+	bool pathFromFile = (argc > 1);
+	if (pathFromFile && ReadPath(argv[1], BestPath) == 0) {
+		printf("\nERROR: \"%s\" IS NOT A VALID PATH OF %d CITIES\nThe program will now exit.\n", argv[1], N); return 1; }
+
+	double bestDist = INFINITY;
+	int bestStart = -1;
+	printf("Now running the local search (%s) from %d starting paths...\n", (LOCAL_SEARCH==0) ? "2-opt" : (LOCAL_SEARCH==1) ? "Or-opt" : (LOCAL_SEARCH==2) ? "2-opt and Or-opt" : "LK chains and Or-opt", STARTS);
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(THREADS)
+	for (int s=0; s<STARTS; s++) {
+		int t = omp_get_thread_num();
+		if (s == 0 && pathFromFile) {
+			for (int i=0; i<N; i++) ThreadsPath[t][i] = BestPath[i];
+			if (IndexPath(t) == 0) { printf("\nERROR: \"%s\" IS NOT A VALID PATH OF %d CITIES\nThe program will now exit.\n", argv[1], N); exit(1); }
+		} else ConstructPath(t, (int)((long long)s * N / STARTS), 1046900 + 1297*s);
+		double startDist = PathDistance_2(ThreadsPath[t]);
+		double totDist = startDist + IteratedLocalSearch(t, 1046900 + 83*s);
+		#pragma omp critical
+		{
+			printf(">> START: %4d  THREAD: %2d  STARTING_PATH_LENGTH: %11.2lf  IMPROVED_PATH_LENGTH: %10.2lf\n", s, t, startDist, totDist);
+			if (totDist < bestDist) {
+				bestDist = totDist; bestStart = s;
+				for (int i=0; i<N+1; i++) BestPath[i] = ThreadsPath[t][i];
+			}
+		}
+	}
+
+	for (int op=0; op<OPERATORS; op++) {
+		long long moves = 0, checks = 0; double gain = 0;
+		for (int t=0; t<THREADS; t++) { moves += OperatorMoves[t][op]; checks += OperatorChecks[t][op]; gain += OperatorGain[t][op]; }
+		printf("> %-7s Moves applied: %10lld  Moves checked: %12lld  Distance gain: %12.2lf\n", OperatorNames[op], moves, checks, gain);
+	}
+	long long kicks = 0; for (int t=0; t<THREADS; t++) kicks += KicksAccepted[t];
+	printf("> Kicks kept: %lld of %lld\n", kicks, (long long)KICKS*STARTS);
+	printf("\nCalculations completed. Results:\n");
+	printf("Best starting path: %d\n", bestStart);
+	printf("Estimation of the optimal path length: %.2lf\n", bestDist);
+	printf("Actual optimal path length: %.2lf\n", PathDistance_2(BestPath));
+	printf("Time: %.3lf seconds\n", omp_get_wtime() - start);
+	if (WRITE_PATH) WritePath(PATH_OUTPUT_FILE, BestPath);
+	return 0 ;
+}
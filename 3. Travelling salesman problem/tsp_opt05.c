@@ -0,0 +1,809 @@
+/*
+Description:
+    This program improves "Travelling Salesman Problem" paths with my implementation of a "Lin-Kernighan" style local search
+	Every thread improves its own starting paths ("Heinritz Hsiao" paths from different starting cities) and the best
+	path of all is kept
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles/Runs/Debugs with: gcc tsp_opt05.c -o tsp_opt05 -lm -O3 -fopt-info -fopenmp -pg && time ./tsp_opt05 [path_file] && gprof ./tsp_opt05
+    Executes the algorithm for 1.000.000 cities, spanning in an area of 1.000x1.000 km
+	Inherits all settings of the previous version unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> Every start draws from its own stream <Streams[s]> of "tsp_rng.h" (construction and kicks) instead of rand_r(),
+        so the result of a start does not depend on the thread that runs it
+    --> The kicks draw their segment lengths and first city with RngBounded(), without the modulo bias of rand_r() % N
+    --> tsp_opt03/04 (rand_r()) and tsp_opt01/02 (rand() for the random path) are left as they were
+*/
+
+
+// **************************************************************************************************************** 
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// **************************************************************************************************************** 
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "omp.h"
+#include "stdbool.h"
+#include "tsp_rng.h"
+#include "tsp_knn.h"
+
+
+// ****************************************************************************************************************
+#define N  1000000
+#define Nx 1000
+#define Ny 1000
+#define THREADS 12
+#define STARTS THREADS       // Starting paths improved (multi-start)
+#define CONSTRUCTION 1       // 0: closest / second closest city paths, 1: space-filling curve path
+#define PICK_CLOSEST_CITY_POSSIBILITY 0.90
+#define NEIGHBORS 10         // Candidate cities per city
+#define CITIES_PER_CELL 2    // Average cities per cell of the grid of BuildCandidateLists()
+#define MIN_GAIN 1e-7        // Moves that shorten the path by less than this are ignored (rounding errors)
+#define LOCAL_SEARCH 3       // 0: 2-opt, 1: Or-opt, 2: 2-opt and Or-opt, 3: LK chains and Or-opt
+#define OR_OPT_MAX_SEGMENT 3 // Maximum number of cities moved by an Or-opt move
+#define LK_MAX_DEPTH 50      // Maximum number of 2-opt moves in a chain
+#define LK_BREADTH_1 10      // Candidates tried on the first move of a chain
+#define LK_BREADTH_2 5       // Candidates tried on the second move of a chain (one on the deeper moves)
+#define KICKS (N/100)        // Double-bridge kicks per starting path (0: plain local search), ~4 ms each at 1M cities
+#define KICK_SEGMENT 50      // Maximum length of the segments exchanged by a kick
+#define JOURNAL_SIZE 4096    // 2-opt moves that can be undone after a kick
+#define MAX_SEGMENTS 8192    // Segments of the two-level lists (at least 4*sqrt(N))
+#define WRITE_PATH 0
+#define PATH_OUTPUT_FILE "tsp_opt05_path.txt"
+
+
+// ****************************************************************************************************************
+float CitiesX[N];
+float CitiesY[N];
+int ThreadsPath[THREADS][N+1]; // The paths as arrays (construction, output); the threads work on their two-level lists
+int CurvePath[N];
+int BestPath[N+1];
+int Neighbors[N][NEIGHBORS]; // The nearest cities of each city, closest first
+Rng Streams[STARTS];          // The random number stream of each start
+double NeighborDistances[N][NEIGHBORS]; // The distances of the cities in <Neighbors>, as given by Distance()
+
+
+// ****************************************************************************************************************
+// Initializes the cities' positions
+// ****************************************************************************************************************
+void SetCities() {
+	printf("Now initializing the positions of the cities...\n");
+	for (int i=0; i<N; i++) {
+		CitiesX[i] = Nx * (float) rand() / RAND_MAX;
+		CitiesY[i] = Ny * (float) rand() / RAND_MAX;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean distance between two cities
+// ****************************************************************************************************************
+double Distance(int A, int B) {
+	return (double) sqrt(   (CitiesX[A]-CitiesX[B])*(CitiesX[A]-CitiesX[B]) + (CitiesY[A]-CitiesY[B])*(CitiesY[A]-CitiesY[B])   );
+}
+
+
+// ****************************************************************************************************************
+// Finds Eucleidian distance in a given path
+// ****************************************************************************************************************
+double PathDistance_2(int Path[]) {
+	double totDist = 0.0;
+	for (int i=0; i<N; i++) {
+		totDist += Distance(Path[i], Path[i+1]);
+	}
+	return totDist;
+}
+
+
+// ****************************************************************************************************************
+// Checks if the path of thread <t> (array) visits every city exactly once and builds its two-level list. Returns 0 if not
+// ****************************************************************************************************************
+void BuildList(int t, const int Path[]);
+int LoadPath(int t) {
+	int *Path = ThreadsPath[t];
+	bool *Visited = calloc(N, sizeof(bool));
+	for (int i=0; i<N; i++) {
+		if (Path[i] < 0 || Path[i] >= N || Visited[Path[i]]) { free(Visited); return 0; }
+		Visited[Path[i]] = true;
+	}
+	free(Visited);
+	Path[N] = Path[0];
+	BuildList(t, Path);
+	return 1;
+}
+
+
+// ****************************************************************************************************************
+// Reads a path from a file into <Path>. Returns 0 if it cannot be read
+// ****************************************************************************************************************
+int ReadPath(const char *filename, int Path[]) {
+	printf("Now reading the path from \"%s\"...\n", filename);
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) return 0;
+	int i = 0;
+	while (i < N && fscanf(file, "%d", &Path[i]) == 1) i++;
+	fclose(file);
+	return (i == N);
+}
+
+
+// ****************************************************************************************************************
+// Writes a path to a file, one city per line
+// ****************************************************************************************************************
+void WritePath(const char *filename, int Path[]) {
+	printf("Now writing the path to \"%s\"...\n", filename);
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) { printf("> ERROR: Cannot open the file.\n"); return; }
+	for (int i=0; i<N; i++) fprintf(file, "%d\n", Path[i]);
+	fclose(file);
+}
+
+
+// ****************************************************************************************************************
+// Builds the lists of the <NEIGHBORS> nearest cities of every city (closest first) with the grid of "tsp_knn.h", and
+// their distances as given by Distance()
+// ****************************************************************************************************************
+void BuildCandidateLists() {
+	KnnBuild(N, NEIGHBORS, CitiesX, CitiesY, Nx, Ny, CITIES_PER_CELL, &Neighbors[0][0], NULL);
+	#pragma omp parallel for schedule(static)
+	for (int c=0; c<N; c++)
+		for (int k=0; k<NEIGHBORS; k++) NeighborDistances[c][k] = Distance(c, Neighbors[c][k]); // The gains of the moves mix both
+}
+
+
+// ****************************************************************************************************************
+// Finds the closest and second closest non-visited cities of <city> by scanning all cities. The squared distances are
+// calculated on the fly in vectorized loops and stored in <Buffer> (N floats), then both minimums are located
+// ****************************************************************************************************************
+void FindClosestCities(int city, const bool CityIsVisited[], float Buffer[], int *closest_city_1, double *min_dist_1, int *closest_city_2, double *min_dist_2) {
+	float x = CitiesX[city], y = CitiesY[city], min_1 = INFINITY, min_2 = INFINITY;
+	#pragma omp simd reduction(min:min_1)
+	for (int i=0; i<N; i++) {
+		float dx = CitiesX[i]-x, dy = CitiesY[i]-y;
+		Buffer[i] = CityIsVisited[i] ? INFINITY : dx*dx + dy*dy; //Visited cities (and <city> itself) are never picked
+		min_1 = fminf(min_1, Buffer[i]);
+	}
+	*closest_city_1 = -1; *closest_city_2 = -1; *min_dist_1 = INFINITY; *min_dist_2 = INFINITY;
+	if (min_1 == INFINITY) return;
+	for (int i=0; i<N; i++) if (Buffer[i] == min_1) { *closest_city_1 = i; break; }
+	Buffer[*closest_city_1] = INFINITY;
+	*min_dist_1 = sqrt(min_1);
+
+	#pragma omp simd reduction(min:min_2)
+	for (int i=0; i<N; i++) min_2 = fminf(min_2, Buffer[i]);
+	if (min_2 == INFINITY) return;
+	for (int i=0; i<N; i++) if (Buffer[i] == min_2) { *closest_city_2 = i; break; }
+	*min_dist_2 = sqrt(min_2);
+}
+
+
+// ****************************************************************************************************************
+// Creates the path of thread <t> starting from <start_city>, by visiting the closest or the second closest non-visited
+// city each time (the candidate lists are used while at least two candidates are non-visited)
+// ****************************************************************************************************************
+void ConstructPath(int t, int start_city, Rng *rng) {
+	int *Path = ThreadsPath[t];
+	bool *CityIsVisited = malloc(sizeof(bool) * N); for (int i=0; i<N; i++) CityIsVisited[i] = false;
+	float *ScanBuffer = malloc(sizeof(float) * N);
+	int current_city = start_city;
+	Path[0] = current_city; CityIsVisited[current_city] = true;
+	for (int visited_cities=1; visited_cities<N; visited_cities++) {
+		double min_dist_1, min_dist_2;
+		int closest_city_1 = -1, closest_city_2 = -1;
+		for (int k=0; k<NEIGHBORS && closest_city_2<0; k++) {
+			int i = Neighbors[current_city][k];
+			if (CityIsVisited[i] == true) continue;
+			if (closest_city_1 < 0) closest_city_1 = i;
+			else closest_city_2 = i;
+		}
+		if (closest_city_2 < 0)
+			FindClosestCities(current_city, CityIsVisited, ScanBuffer, &closest_city_1, &min_dist_1, &closest_city_2, &min_dist_2);
+		float random_number = RngFloat(rng);
+		int next_city = (random_number<PICK_CLOSEST_CITY_POSSIBILITY || closest_city_2<0) ? closest_city_1 : closest_city_2;
+		Path[visited_cities] = next_city; CityIsVisited[next_city] = true;
+		current_city = next_city;
+	}
+	free(CityIsVisited); free(ScanBuffer);
+	LoadPath(t);
+}
+
+
+// ****************************************************************************************************************
+// Two-level doubly-linked list of the path of every thread: the path is split in segments of consecutive cities, kept
+// in a doubly-linked list (<SegmentNext>, <SegmentPrev>, numbered along the path by <SegmentRank>). The cities of a
+// segment are stored in <Pool> (from <SegmentStart>, <SegmentLength> cities) in path order, or in reverse order when the
+// segment's <SegmentReversed> bit is set. A reversal of many cities only reverses the order of whole segments and
+// flips their bits, so every operation costs O(sqrt(N))
+// ****************************************************************************************************************
+int Pool[THREADS][N];           // The cities of the segments
+int PoolPosition[THREADS][N];   // Pool[t][PoolPosition[t][c]] == c
+int SegmentOfCity[THREADS][N];
+int SegmentStart[THREADS][MAX_SEGMENTS], SegmentLength[THREADS][MAX_SEGMENTS];
+int SegmentNext[THREADS][MAX_SEGMENTS], SegmentPrev[THREADS][MAX_SEGMENTS], SegmentRank[THREADS][MAX_SEGMENTS];
+bool SegmentReversed[THREADS][MAX_SEGMENTS];
+int Segments[THREADS];          // Segments in use
+int SegmentList[THREADS][MAX_SEGMENTS];
+int GroupSize, SegmentLimit;    // Cities per segment when the list is built, segments allowed before it is rebuilt
+
+
+// ****************************************************************************************************************
+// The first and last cities of segment <s> of thread <t>, in path order
+// ****************************************************************************************************************
+static inline int First(int t, int s) { return Pool[t][SegmentReversed[t][s] ? SegmentStart[t][s] + SegmentLength[t][s] - 1 : SegmentStart[t][s]]; }
+static inline int Last(int t, int s) { return Pool[t][SegmentReversed[t][s] ? SegmentStart[t][s] : SegmentStart[t][s] + SegmentLength[t][s] - 1]; }
+
+
+// ****************************************************************************************************************
+// The next and previous cities of a city in the path of thread <t>
+// ****************************************************************************************************************
+static inline int Next(int t, int city) {
+	int s = SegmentOfCity[t][city], p = PoolPosition[t][city] + (SegmentReversed[t][s] ? -1 : 1);
+	if (p < SegmentStart[t][s] || p >= SegmentStart[t][s] + SegmentLength[t][s]) return First(t, SegmentNext[t][s]);
+	return Pool[t][p];
+}
+
+static inline int Prev(int t, int city) {
+	int s = SegmentOfCity[t][city], p = PoolPosition[t][city] + (SegmentReversed[t][s] ? 1 : -1);
+	if (p < SegmentStart[t][s] || p >= SegmentStart[t][s] + SegmentLength[t][s]) return Last(t, SegmentPrev[t][s]);
+	return Pool[t][p];
+}
+
+
+// ****************************************************************************************************************
+// The order of a city along the path of thread <t>, starting from the segment with rank 0
+// ****************************************************************************************************************
+static inline long long Order(int t, int city) {
+	int s = SegmentOfCity[t][city], p = PoolPosition[t][city] - SegmentStart[t][s];
+	return (long long) SegmentRank[t][s] * N + (SegmentReversed[t][s] ? SegmentLength[t][s] - 1 - p : p);
+}
+
+
+// ****************************************************************************************************************
+// Checks if city B is met when following the path of thread <t> from city A to city C (A and C included)
+// ****************************************************************************************************************
+bool Between(int t, int A, int B, int C) {
+	long long a = Order(t, A), b = Order(t, B), c = Order(t, C);
+	if (a <= c) return (a <= b && b <= c);
+	return (b >= a || b <= c);
+}
+
+
+// ****************************************************************************************************************
+// Numbers the segments of thread <t> along the path
+// ****************************************************************************************************************
+void RankSegments(int t) {
+	int s = SegmentOfCity[t][0];
+	for (int r=0; r<Segments[t]; r++, s = SegmentNext[t][s]) SegmentRank[t][s] = r;
+}
+
+
+// ****************************************************************************************************************
+// Builds the list of thread <t> from the path <Path> (N cities), with segments of <GroupSize> cities
+// ****************************************************************************************************************
+void BuildList(int t, const int Path[]) {
+	Segments[t] = (N + GroupSize - 1) / GroupSize;
+	for (int s=0; s<Segments[t]; s++) {
+		SegmentStart[t][s] = s*GroupSize;
+		SegmentLength[t][s] = (s < Segments[t]-1) ? GroupSize : N - s*GroupSize;
+		SegmentReversed[t][s] = false;
+		SegmentNext[t][s] = (s+1) % Segments[t];
+		SegmentPrev[t][s] = (s+Segments[t]-1) % Segments[t];
+	}
+	for (int i=0; i<N; i++) {
+		Pool[t][i] = Path[i]; PoolPosition[t][Path[i]] = i; SegmentOfCity[t][Path[i]] = i / GroupSize;
+	}
+	RankSegments(t);
+}
+
+
+// ****************************************************************************************************************
+// Copies the cities of segment <s> of thread <t> from pool position <from> to <to> (both included, in path order) to
+// <Path>, starting at position <n>. Returns the position after the last copied city
+// ****************************************************************************************************************
+static inline int CopySegment(int t, int s, int from, int to, int Path[], int n) {
+	if (SegmentReversed[t][s]) for (int i=from; i>=to; i--) Path[n++] = Pool[t][i];
+	else for (int i=from; i<=to; i++) Path[n++] = Pool[t][i];
+	return n;
+}
+
+
+// ****************************************************************************************************************
+// Writes the path of thread <t> to <Path> (N+1 cities, starting and ending at city 0): the pool range of every segment
+// is copied in the order of the segments (reversed when its bit is set), instead of following Next() city by city
+// ****************************************************************************************************************
+void StorePath(int t, int Path[]) {
+	int s = SegmentOfCity[t][0], p = PoolPosition[t][0], n = 0;
+	int first = SegmentStart[t][s], last = first + SegmentLength[t][s] - 1;
+	bool reversed = SegmentReversed[t][s];
+	n = CopySegment(t, s, p, reversed ? first : last, Path, n); // City 0 and the rest of its segment
+	for (int u=SegmentNext[t][s]; u!=s; u=SegmentNext[t][u]) {
+		int start = SegmentStart[t][u], end = start + SegmentLength[t][u] - 1;
+		n = SegmentReversed[t][u] ? CopySegment(t, u, end, start, Path, n) : CopySegment(t, u, start, end, Path, n);
+	}
+	if (reversed && p < last) n = CopySegment(t, s, last, p+1, Path, n);   // The cities of the segment of city 0 before it
+	if (!reversed && p > first) n = CopySegment(t, s, first, p-1, Path, n);
+	Path[N] = Path[0];
+}
+
+
+// ****************************************************************************************************************
+// Makes <city> the first city of its segment, by moving the cities before it to a new segment (the cities of the
+// smaller part are relabeled). The segments must be ranked again afterwards
+// ****************************************************************************************************************
+void SplitBefore(int t, int city) {
+	int s = SegmentOfCity[t][city];
+	if (First(t, s) == city) return;
+	int start = SegmentStart[t][s], length = SegmentLength[t][s], p = PoolPosition[t][city];
+	bool reversed = SegmentReversed[t][s];
+	// The pool part of the cities before <city> in the path, and the part from <city> to the end of the segment
+	int headStart = (reversed) ? p+1 : start, headLength = (reversed) ? start+length-1-p : p-start;
+	int tailStart = (reversed) ? start : p, tailLength = length - headLength;
+	int u = Segments[t]++;
+	SegmentReversed[t][u] = reversed;
+	if (headLength <= tailLength) { // The new segment takes the head, before <s>
+		SegmentStart[t][u] = headStart; SegmentLength[t][u] = headLength;
+		SegmentStart[t][s] = tailStart; SegmentLength[t][s] = tailLength;
+		SegmentPrev[t][u] = SegmentPrev[t][s]; SegmentNext[t][SegmentPrev[t][s]] = u;
+		SegmentNext[t][u] = s; SegmentPrev[t][s] = u;
+	} else {                        // The new segment takes the tail, after <s>
+		SegmentStart[t][u] = tailStart; SegmentLength[t][u] = tailLength;
+		SegmentStart[t][s] = headStart; SegmentLength[t][s] = headLength;
+		SegmentNext[t][u] = SegmentNext[t][s]; SegmentPrev[t][SegmentNext[t][s]] = u;
+		SegmentPrev[t][u] = s; SegmentNext[t][s] = u;
+	}
+	for (int i=SegmentStart[t][u]; i<SegmentStart[t][u]+SegmentLength[t][u]; i++) SegmentOfCity[t][Pool[t][i]] = u;
+}
+
+
+// ****************************************************************************************************************
+// Reverses the order of the segments from <s1> to <s2> (following the path) and flips their bits. The reversed
+// segments take the ranks of their places
+// ****************************************************************************************************************
+void ReverseSegments(int t, int s1, int s2) {
+	int before = SegmentPrev[t][s1], after = SegmentNext[t][s2], m = 0;
+	for (int s=s1; ; s = SegmentNext[t][s]) { SegmentList[t][m++] = s; if (s == s2) break; }
+	for (int k=0; k<m/2; k++) {
+		int A = SegmentList[t][k], B = SegmentList[t][m-1-k], temp = SegmentRank[t][A];
+		SegmentRank[t][A] = SegmentRank[t][B]; SegmentRank[t][B] = temp;
+	}
+	for (int k=0; k<m; k++) {
+		int s = SegmentList[t][k];
+		SegmentReversed[t][s] = !SegmentReversed[t][s];
+		SegmentNext[t][s] = (k > 0) ? SegmentList[t][k-1] : after;
+		SegmentPrev[t][s] = (k < m-1) ? SegmentList[t][k+1] : before;
+	}
+	SegmentNext[t][before] = SegmentList[t][m-1];
+	SegmentPrev[t][after] = SegmentList[t][0];
+}
+
+
+// ****************************************************************************************************************
+// Reverses the pool positions from <i> to <j> (i <= j, inside one segment)
+// ****************************************************************************************************************
+void ReversePool(int t, int i, int j) {
+	for (; i<j; i++, j--) {
+		int A = Pool[t][i], B = Pool[t][j];
+		Pool[t][i] = B; PoolPosition[t][B] = i;
+		Pool[t][j] = A; PoolPosition[t][A] = j;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Reverses the part of the path of thread <t> from city A to city B (following the path, both included). Reversing the
+// rest of the path instead gives the same tour, so the part with the fewer segments is reversed. When the list has
+// too many (small) segments, it is built again from the path
+// ****************************************************************************************************************
+void ReversePath(int t, int A, int B) {
+	if (Next(t, B) == A) return; //The whole path: the tour does not change
+	int s = SegmentOfCity[t][A];
+	if (s == SegmentOfCity[t][B]) { // Inside one segment: the cities are reversed in the pool
+		int a = PoolPosition[t][A], b = PoolPosition[t][B];
+		if (Order(t, A) <= Order(t, B)) { ReversePool(t, (a < b) ? a : b, (a < b) ? b : a); return; }
+		a = PoolPosition[t][Next(t, B)]; b = PoolPosition[t][Prev(t, A)]; // The rest of the path is inside the segment
+		ReversePool(t, (a < b) ? a : b, (a < b) ? b : a); return;
+	}
+	if (Segments[t] + 2 > SegmentLimit) { StorePath(t, ThreadsPath[t]); BuildList(t, ThreadsPath[t]); }
+	int segments = Segments[t];
+	SplitBefore(t, A);
+	SplitBefore(t, Next(t, B));
+	if (Segments[t] != segments) RankSegments(t);
+	int s1 = SegmentOfCity[t][A], s2 = SegmentOfCity[t][B];
+	int m = (SegmentRank[t][s2] - SegmentRank[t][s1] + Segments[t]) % Segments[t] + 1;
+	if (2*m <= Segments[t]) ReverseSegments(t, s1, s2);
+	else ReverseSegments(t, SegmentNext[t][s2], SegmentPrev[t][s1]);
+}
+
+
+// ****************************************************************************************************************
+// Queues of the cities whose don't-look bit is off (<InQueue>), one per thread
+// ****************************************************************************************************************
+int Queue[THREADS][N], QueueHead[THREADS], QueueSize[THREADS];
+bool InQueue[THREADS][N];
+
+void Push(int t, int city) {
+	if (InQueue[t][city]) return;
+	Queue[t][(QueueHead[t] + QueueSize[t]++) % N] = city; InQueue[t][city] = true;
+}
+
+int Pop(int t) {
+	int city = Queue[t][QueueHead[t]]; QueueHead[t] = (QueueHead[t]+1) % N; QueueSize[t]--;
+	InQueue[t][city] = false;
+	return city;
+}
+
+
+// ****************************************************************************************************************
+// Statistics of the local search operators, per thread
+// ****************************************************************************************************************
+#define OPERATORS 3
+const char *OperatorNames[OPERATORS] = {"2-opt", "Or-opt", "LK"};
+long long OperatorMoves[THREADS][OPERATORS], OperatorChecks[THREADS][OPERATORS];
+double OperatorGain[THREADS][OPERATORS];
+long long KicksAccepted[THREADS];
+
+
+// ****************************************************************************************************************
+// Replaces the edges T1-T2 and T3-T4 by T1-T3 and T2-T4 in the path of thread <t>. T2 must follow T1 in the path in the
+// same direction that T4 follows T3 (both next or both previous cities). While <Journaling> is on, the move is recorded
+// in the journal of the thread; Make2OptMove(T1, T3, T2, T4) undoes it, and removes it from the journal instead
+// ****************************************************************************************************************
+int Journal[THREADS][JOURNAL_SIZE][4], JournalLength[THREADS];
+bool Journaling[THREADS];
+
+void Make2OptMove(int t, int T1, int T2, int T3, int T4) {
+	if (Next(t, T1) == T2) ReversePath(t, T2, T3); // T1 T2 ... T3 T4 -> T1 T3 ... T2 T4
+	else ReversePath(t, T1, T4);                   // T2 T1 ... T4 T3 -> T2 T4 ... T1 T3
+	if (Journaling[t]) {
+		int last = JournalLength[t]-1, *Move = Journal[t][(last >= 0 && last < JOURNAL_SIZE) ? last : 0];
+		if (last >= 0 && last < JOURNAL_SIZE && Move[0] == T1 && Move[1] == T3 && Move[2] == T2 && Move[3] == T4) JournalLength[t] --;
+		else {
+			if (JournalLength[t] < JOURNAL_SIZE) { Move = Journal[t][JournalLength[t]]; Move[0] = T1; Move[1] = T2; Move[2] = T3; Move[3] = T4; }
+			JournalLength[t] ++;
+		}
+	}
+}
+
+
+// ****************************************************************************************************************
+// Tries the 2-opt moves around city A and applies the first one that shortens the path. Returns the change of the
+// path distance (0 if no move was applied). For the path neighbor B of A (next or previous) and a candidate city C with
+// path neighbor D (on the same side), the edges A-B and C-D are replaced by A-C and B-D
+// ****************************************************************************************************************
+double TryTwoOptMove(int t, int A) {
+	for (int direction=0; direction<2; direction++) { // 0: A-B is followed by the path, 1: B-A
+		int B = (direction==0) ? Next(t, A) : Prev(t, A);
+		double dist1_old = Distance(A, B);
+		for (int k=0; k<NEIGHBORS; k++) {
+			int C = Neighbors[A][k];
+			double dist1_new = NeighborDistances[A][k];
+			if (dist1_new >= dist1_old) break; //The candidates are sorted, so no other move can shorten the path
+			int D = (direction==0) ? Next(t, C) : Prev(t, C);
+			if (C == B || D == A) continue;
+			OperatorChecks[t][0] ++;
+			double dist2_old = Distance(C, D);
+			double dist2_new = Distance(B, D);
+			double distChange = - dist1_old - dist2_old + dist1_new + dist2_new;
+			if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+				Make2OptMove(t, A, B, C, D);
+				Push(t, A); Push(t, B); Push(t, C); Push(t, D);
+				return distChange;
+			}
+		}
+	}
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// Tries to move the segment S1...S2 (from city A onwards, 1 to <OR_OPT_MAX_SEGMENT> cities) between the consecutive
+// cities U-V (V = Next(U)), next to a candidate city of S1 or S2, and applies the first move that shortens the path.
+// Returns the change of the path distance (0 if no move was applied). P-S1...S2-N and U-V become P-N and U-S1...S2-V
+// (or U-S2...S1-V when the segment is reversed)
+// ****************************************************************************************************************
+double TryOrOptMove(int t, int A) {
+	int S1 = A, S2 = A;
+	for (int length=1; length<=OR_OPT_MAX_SEGMENT && length<N-2; length++, S2 = Next(t, S2)) {
+		int P = Prev(t, S1), NX = Next(t, S2);
+		double dist1_old = Distance(P, S1);
+		double dist2_old = Distance(S2, NX);
+		double dist1_new = Distance(P, NX);
+		double removalGain = dist1_old + dist2_old - dist1_new;
+		if (removalGain <= MIN_GAIN) continue;
+
+		for (int end=0; end<2; end++) { // The candidates of S1 and then of S2
+			int E = (end==0) ? S1 : S2;
+			for (int k=0; k<NEIGHBORS; k++) {
+				int C = Neighbors[E][k];
+				if (NeighborDistances[E][k] >= removalGain) break; //The candidates are sorted, so no other move can shorten the path
+				if (Between(t, S1, C, S2)) continue; //C is in the segment
+				for (int side=0; side<2; side++) { // Between C and its next city, or its previous city and C
+					int U = (side==0) ? C : Prev(t, C), V = (side==0) ? Next(t, C) : C;
+					if (Between(t, S1, U, S2) || Between(t, S1, V, S2)) continue;
+					OperatorChecks[t][1] ++;
+					double dist3_old = Distance(U, V);
+					double dist2_new = Distance(U, S1) + Distance(S2, V); // U-S1...S2-V
+					double dist3_new = Distance(U, S2) + Distance(S1, V); // U-S2...S1-V
+					bool reversed = (dist3_new < dist2_new);
+					double distChange = - dist1_old - dist2_old - dist3_old + dist1_new + ((reversed) ? dist3_new : dist2_new);
+					if (distChange < -MIN_GAIN) { //Must be <0 if it decreases the total distance
+						if (U == NX) Make2OptMove(t, P, S1, NX, Next(t, NX));         // P S1...S2 N V -> P N S2...S1 V
+						else if (V == P) Make2OptMove(t, U, P, S2, NX);               // U P S1...S2 N -> U S2...S1 P N
+						else { Make2OptMove(t, P, S1, U, V); Make2OptMove(t, P, U, NX, S2); } // -> P U ... N S2...S1 V -> P N ... U S2...S1 V
+						if (!reversed && length > 1) Make2OptMove(t, U, S2, S1, V); // U S2...S1 V -> U S1...S2 V
+						Push(t, P); Push(t, NX); Push(t, S1); Push(t, S2); Push(t, U); Push(t, V);
+						return distChange;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// State of the chain of TryLKMove(), per thread
+// ****************************************************************************************************************
+int ChainCities[THREADS][LK_MAX_DEPTH][4];  // T1, T2, T3, T4 of every move of the chain
+double ChainBestGain[THREADS];
+int ChainBestDepth[THREADS];
+
+
+// ****************************************************************************************************************
+// Adds the move <depth> of the chain: T1-T2 is removed and T2-T3 is added for a candidate city T3 of T2, and T3-T4 is
+// removed so that the path closes with T1-T4. <gain> is the sum of the removed minus the added edges so far. Keeps the
+// moves up to the best closed path found by the chain (<ChainBestDepth>) and undoes the rest
+// ****************************************************************************************************************
+void ExtendChain(int t, int depth, int T1, int T2, double gain) {
+	int tried = 0;
+	for (int k=0; k<NEIGHBORS && tried<((depth==0) ? LK_BREADTH_1 : (depth==1) ? LK_BREADTH_2 : 1); k++) {
+		int T3 = Neighbors[T2][k];
+		double gain_1 = gain - NeighborDistances[T2][k];
+		if (gain_1 <= MIN_GAIN) break; //The candidates are sorted, so no other city can continue the chain
+		if (T3 == T1 || T3 == Next(t, T2) || T3 == Prev(t, T2)) continue;
+		int T4 = (Next(t, T1) == T2) ? Prev(t, T3) : Next(t, T3);
+		bool added = false; // T3-T4 must not be an edge added by the chain
+		for (int d=0; d<depth && !added; d++)
+			added = (ChainCities[t][d][1] == T3 && ChainCities[t][d][2] == T4) || (ChainCities[t][d][1] == T4 && ChainCities[t][d][2] == T3);
+		if (added) continue;
+		tried ++; OperatorChecks[t][2] ++;
+
+		double gain_2 = gain_1 + Distance(T3, T4);
+		Make2OptMove(t, T2, T1, T3, T4); // T1 T2 ... T4 T3 -> T1 T4 ... T2 T3
+		ChainCities[t][depth][0] = T1; ChainCities[t][depth][1] = T2; ChainCities[t][depth][2] = T3; ChainCities[t][depth][3] = T4;
+		if (gain_2 - Distance(T4, T1) > ChainBestGain[t]) { ChainBestGain[t] = gain_2 - Distance(T4, T1); ChainBestDepth[t] = depth+1; }
+		if (depth+1 < LK_MAX_DEPTH) ExtendChain(t, depth+1, T1, T4, gain_2);
+		if (ChainBestGain[t] > MIN_GAIN) { // Keep the moves up to the best depth
+			if (depth+1 > ChainBestDepth[t]) Make2OptMove(t, T2, T3, T1, T4);
+			return;
+		}
+		Make2OptMove(t, T2, T3, T1, T4);
+	}
+}
+
+
+// ****************************************************************************************************************
+// Tries the chains of 2-opt moves that start by removing an edge of city A and applies the first one that shortens the
+// path. Returns the change of the path distance (0 if no chain was applied)
+// ****************************************************************************************************************
+double TryLKMove(int t, int A) {
+	for (int direction=0; direction<2; direction++) {
+		int B = (direction==0) ? Next(t, A) : Prev(t, A);
+		ChainBestGain[t] = 0; ChainBestDepth[t] = 0;
+		ExtendChain(t, 0, A, B, Distance(A, B));
+		if (ChainBestGain[t] > MIN_GAIN) {
+			for (int d=0; d<ChainBestDepth[t]; d++)
+				for (int c=0; c<4; c++) Push(t, ChainCities[t][d][c]);
+			return -ChainBestGain[t];
+		}
+	}
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// Puts every city of the path of thread <t> in its queue
+// ****************************************************************************************************************
+void ResetQueue(int t) {
+	for (int c=0; c<N; c++) { InQueue[t][c] = false; }
+	QueueHead[t] = 0; QueueSize[t] = 0;
+	int city = 0;
+	for (int i=0; i<N; i++, city = Next(t, city)) Push(t, city);
+}
+
+
+// ****************************************************************************************************************
+// Applies the improving moves of the operators selected by <LOCAL_SEARCH> to the path of thread <t> until none is left
+// and returns the total change of the path distance. Only the cities in the queue are examined (don't-look bits)
+// ****************************************************************************************************************
+double LocalSearch(int t) {
+	double totDistChange = 0.0;
+	while (QueueSize[t] > 0) {
+		int A = Pop(t);
+		double distChange = 0;
+		int op = (LOCAL_SEARCH == 3) ? 2 : 0;
+		if (LOCAL_SEARCH != 1) {
+			distChange = (op == 2) ? TryLKMove(t, A) : TryTwoOptMove(t, A);
+			if (distChange < 0) { OperatorMoves[t][op] ++; OperatorGain[t][op] -= distChange; totDistChange += distChange; continue; }
+		}
+		if (LOCAL_SEARCH != 0) {
+			distChange = TryOrOptMove(t, A);
+			if (distChange < 0) { OperatorMoves[t][1] ++; OperatorGain[t][1] -= distChange; totDistChange += distChange; }
+		}
+	}
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// Exchanges two consecutive random segments of the path of thread <t> (double-bridge kick): A B...B' C...C' D becomes
+// A C...C' B...B' D. The six cities around the segments are queued. Returns the change of the path distance
+// ****************************************************************************************************************
+double DoubleBridgeKick(int t, Rng *rng) {
+	int maxSegment = (KICK_SEGMENT < N/8) ? KICK_SEGMENT : N/8;
+	int L1 = 1 + RngBounded(rng, maxSegment), L2 = 1 + RngBounded(rng, maxSegment);
+	int A = RngBounded(rng, N), B1 = Next(t, A), B2 = B1;
+	for (int i=1; i<L1; i++) B2 = Next(t, B2);
+	int C1 = Next(t, B2), C2 = C1;
+	for (int i=1; i<L2; i++) C2 = Next(t, C2);
+	int D = Next(t, C2);
+	double dist1_old = Distance(A, B1);
+	double dist2_old = Distance(B2, C1);
+	double dist3_old = Distance(C2, D);
+	double dist1_new = Distance(A, C1);
+	double dist2_new = Distance(C2, B1);
+	double dist3_new = Distance(B2, D);
+	Make2OptMove(t, A, B1, B2, C1);  // A B'...B C...C' D
+	Make2OptMove(t, B1, C1, C2, D);  // A B'...B C'...C D
+	Make2OptMove(t, A, B2, C1, D);   // A C...C' B...B' D
+	Push(t, A); Push(t, B1); Push(t, B2); Push(t, C1); Push(t, C2); Push(t, D);
+	return - dist1_old - dist2_old - dist3_old + dist1_new + dist2_new + dist3_new;
+}
+
+
+// ****************************************************************************************************************
+// Improves the path of thread <t> with the local search and then with <KICKS> kicks: every kick is followed by the local
+// search around it and is undone (from the journal of 2-opt moves) if the path did not become shorter. Returns the total
+// change of the path distance
+// ****************************************************************************************************************
+double IteratedLocalSearch(int t, Rng *rng) {
+	ResetQueue(t);
+	double totDistChange = LocalSearch(t);
+	if (N < 8) return totDistChange;
+	for (int kick=0; kick<KICKS; kick++) {
+		long long SavedMoves[OPERATORS]; double SavedGain[OPERATORS];
+		for (int op=0; op<OPERATORS; op++) { SavedMoves[op] = OperatorMoves[t][op]; SavedGain[op] = OperatorGain[t][op]; }
+		JournalLength[t] = 0; Journaling[t] = true;
+		double distChange = DoubleBridgeKick(t, rng);
+		distChange += LocalSearch(t);
+		Journaling[t] = false;
+		if (distChange < -MIN_GAIN || JournalLength[t] > JOURNAL_SIZE) { //Kept (also when the journal overflowed and it cannot be undone)
+			totDistChange += distChange; KicksAccepted[t] ++;
+		} else {
+			for (int k=JournalLength[t]-1; k>=0; k--) Make2OptMove(t, Journal[t][k][0], Journal[t][k][2], Journal[t][k][1], Journal[t][k][3]);
+			for (int op=0; op<OPERATORS; op++) { OperatorMoves[t][op] = SavedMoves[op]; OperatorGain[t][op] = SavedGain[op]; }
+		}
+	}
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// The index of the cell (x, y) along a Hilbert curve that covers a 2^16 x 2^16 grid
+// ****************************************************************************************************************
+long long HilbertIndex(unsigned x, unsigned y) {
+	long long d = 0;
+	for (unsigned s=1u<<15; s>0; s/=2) {
+		unsigned rx = (x & s) > 0, ry = (y & s) > 0;
+		d += (long long) s * s * ((3 * rx) ^ ry);
+		if (ry == 0) {
+			if (rx == 1) { x = s-1 - x; y = s-1 - y; }
+			unsigned temp = x; x = y; y = temp;
+		}
+	}
+	return d;
+}
+
+
+// ****************************************************************************************************************
+// Creates the path <CurvePath> that visits the cities in the order of a Hilbert curve over the area
+// ****************************************************************************************************************
+int CompareCurveKeys(const void *A, const void *B) {
+	long long a = ((const long long *)A)[0], b = ((const long long *)B)[0];
+	return (a > b) - (a < b);
+}
+
+void SpaceFillingCurvePath() {
+	printf("Now creating the space-filling curve path...\n");
+	long long (*Keys)[2] = malloc(sizeof(long long[2]) * N);
+	#pragma omp parallel for schedule(static)
+	for (int c=0; c<N; c++) {
+		unsigned x = (unsigned)(65535.0f * CitiesX[c] / Nx), y = (unsigned)(65535.0f * CitiesY[c] / Ny);
+		Keys[c][0] = HilbertIndex(x, y); Keys[c][1] = c;
+	}
+	qsort(Keys, N, sizeof(long long[2]), CompareCurveKeys);
+	for (int i=0; i<N; i++) CurvePath[i] = (int) Keys[i][1];
+	free(Keys);
+}
+
+
+// ****************************************************************************************************************
+// The main program
+// ****************************************************************************************************************
+int main( int argc, const char* argv[] ) {
+	printf("------------------------------------------------------------------------------\n");
+	printf("This program searches for the optimal traveling distance between %d cities,\n", N);
+	printf("spanning in an area of X=(0,%d) and Y=(0,%d)\n", Nx, Ny);
+	printf("------------------------------------------------------------------------------\n");
+
+	srand(1046900);
+	RngStreams(Streams, STARTS, 1046900);
+	SetCities();
+	double start = omp_get_wtime();
+	BuildCandidateLists();
+
+	bool pathFromFile = (argc > 1);
+	if (pathFromFile && ReadPath(argv[1], BestPath) == 0) {
+		printf("\nERROR: \"%s\" IS NOT A VALID PATH OF %d CITIES\nThe program will now exit.\n", argv[1], N); return 1; }
+
+	GroupSize = (int) sqrt(N); if (GroupSize < 8) GroupSize = 8;
+	SegmentLimit = 4 * ((N + GroupSize - 1) / GroupSize); if (SegmentLimit > MAX_SEGMENTS) SegmentLimit = MAX_SEGMENTS;
+	if (CONSTRUCTION == 1) SpaceFillingCurvePath();
+
+	double bestDist = INFINITY;
+	int bestStart = -1;
+	printf("Now running the local search (%s) from %d starting paths...\n", (LOCAL_SEARCH==0) ? "2-opt" : (LOCAL_SEARCH==1) ? "Or-opt" : (LOCAL_SEARCH==2) ? "2-opt and Or-opt" : "LK chains and Or-opt", STARTS);
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(THREADS)
+	for (int s=0; s<STARTS; s++) {
+		int t = omp_get_thread_num();
+		if (s == 0 && pathFromFile) {
+			for (int i=0; i<N; i++) ThreadsPath[t][i] = BestPath[i];
+			if (LoadPath(t) == 0) { printf("\nERROR: \"%s\" IS NOT A VALID PATH OF %d CITIES\nThe program will now exit.\n", argv[1], N); exit(1); }
+		} else if (CONSTRUCTION == 1) {
+			for (int i=0; i<N; i++) ThreadsPath[t][i] = CurvePath[i];
+			LoadPath(t);
+		} else ConstructPath(t, (int)((long long)s * N / STARTS), &Streams[s]);
+		double startDist = PathDistance_2(ThreadsPath[t]);
+		double totDist = startDist + IteratedLocalSearch(t, &Streams[s]);
+		StorePath(t, ThreadsPath[t]);
+		#pragma omp critical
+		{
+			printf(">> START: %4d  THREAD: %2d  STARTING_PATH_LENGTH: %11.2lf  IMPROVED_PATH_LENGTH: %10.2lf\n", s, t, startDist, totDist);
+			if (totDist < bestDist) {
+				bestDist = totDist; bestStart = s;
+				for (int i=0; i<N+1; i++) BestPath[i] = ThreadsPath[t][i];
+			}
+		}
+	}
+
+	for (int op=0; op<OPERATORS; op++) {
+		long long moves = 0, checks = 0; double gain = 0;
+		for (int t=0; t<THREADS; t++) { moves += OperatorMoves[t][op]; checks += OperatorChecks[t][op]; gain += OperatorGain[t][op]; }
+		printf("> %-7s Moves applied: %10lld  Moves checked: %12lld  Distance gain: %12.2lf\n", OperatorNames[op], moves, checks, gain);
+	}
+	long long kicks = 0; for (int t=0; t<THREADS; t++) kicks += KicksAccepted[t];
+	printf("> Kicks kept: %lld of %lld\n", kicks, (long long)KICKS*STARTS);
+	printf("\nCalculations completed. Results:\n");
+	printf("Best starting path: %d\n", bestStart);
+	printf("Estimation of the optimal path length: %.2lf\n", bestDist);
+	printf("Actual optimal path length: %.2lf\n", PathDistance_2(BestPath));
+	printf("Time: %.3lf seconds\n", omp_get_wtime() - start);
+	if (WRITE_PATH) WritePath(PATH_OUTPUT_FILE, BestPath);
+	return 0 ;
+}
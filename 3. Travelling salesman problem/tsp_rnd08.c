@@ -0,0 +1,313 @@
+/*
+Description:
+    This program executes my "Random Swapping" algorithm to solve the "Travelling Salesman Problem"
+	Abides by Lab 3 Exercise 2 requirements
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles/Runs/Debugs with: gcc tsp_rnd08.c -o tsp_rnd08 -lm -fopt-info -fopenmp -O3 -pg && time ./tsp_rnd08 && gprof ./tsp_rnd08
+	Executes the algorithm for 10.000 cities, spanning in an area of 1.000x1.000 km and produces correct results
+	Inherits all settings of the previous version unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> The locks were removed: on every repetition the positions 1..N-1 of the path are split in <THREADS> consecutive
+        segments, one per thread. A thread swaps only cities whose positions and neighbor positions are inside its own
+        segment, so no two threads ever touch the same position
+    --> The boundaries of the segments are shifted by a random offset on every repetition, so the cities next to a
+        boundary can be swapped in the next repetitions
+    --> Every thread keeps its own <rand_r> seed (<Seeds>), seeded once at the start, instead of seeding on every step
+        with omp_get_wtime(); the critical section for the case A==B was removed (B is drawn again by the same thread)
+        The seed is copied into a local variable for the swaps of a repetition and written back at the end, since the
+        <Seeds> of neighboring threads share cache lines
+    --> The number of swaps tried per second is printed on every repetition
+*/	
+
+
+// ****************************************************************************************************************    
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// **************************************************************************************************************** 
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "omp.h"
+
+
+// ****************************************************************************************************************
+#define N  10000
+#define Nx 1000
+#define Ny 1000
+#define VACANT_POSITION_CODE -999999
+
+#define THREADS 12
+#define STEPS_PER_THREAD_PER_REPETITION 100000//200000000
+#define DEFAULT_MAX_REPETITIONS 1e6//1e6
+#define THRESHOLD_DISTANCE 0//600000
+
+#define DEBUG 1
+
+
+// ****************************************************************************************************************
+float CitiesX[N];
+float CitiesY[N];
+int Path[N+1];
+unsigned Seeds[THREADS]; // The random seed of each thread
+
+
+// ****************************************************************************************************************
+// Initializes the cities' positions
+// ****************************************************************************************************************
+void SetCities() {
+	printf("Now initializing the positions of the cities...\n");
+	for (int i=0; i<N; i++) {
+		CitiesX[i] = Nx * (float) rand() / RAND_MAX;
+		CitiesY[i] = Ny * (float) rand() / RAND_MAX;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Initializes the traveling path
+// ****************************************************************************************************************
+void ResetPath() {
+	printf("Now initializing the path...\n");
+	for (int i=0; i<N+1; i++)
+		Path[i] = -1;
+}
+
+
+// ****************************************************************************************************************
+// Checks if a city is already in the path
+// ****************************************************************************************************************
+int IsInPath(int k) {
+	for (int i=0; i<N; i++)
+		if (Path[i] == k) return 1;
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// Creates a random path
+// ****************************************************************************************************************
+void RandomizePath() {
+	int k;
+	printf("Now randomizing the path...\n");
+
+	Path[0] = (N*rand())/RAND_MAX;
+	Path[N] = Path[0];
+
+	for (int i=1; i<N; i++) {
+		
+		do {
+			k = ((float)N*rand())/RAND_MAX;
+		} while (IsInPath(k) == 1);
+		Path[i] = k;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Prints the cities' positions
+// ****************************************************************************************************************
+void PrintCities() {
+	printf("> The cities are:\n");
+	for (int i=0; i<N; i++) {
+		printf(">> City: %6d  X:%5.2f Y:%5.2f\n", i, CitiesX[i], CitiesY[i] );
+	}
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Visually maps the cities' positions
+// ****************************************************************************************************************
+void MapCities() {
+	int Map[Ny+1][Nx+1];
+	printf("Now creating a visual map of the cities...\n");
+	for (int i=0; i<Nx+1; i++) 
+		for (int j=0; j<Ny+1; j++) 
+			Map[j][i] = (float) VACANT_POSITION_CODE;
+
+
+	//printf("Quantized coordinates are:\n");
+	for (int c=0; c<N; c++) {
+		int x = (int) CitiesX[c] ;
+		int y = (int) CitiesY[c] ;
+		//printf(" City:%d  y=%d and x=%d\n",c,y,x);
+		if (Map[y][x] == VACANT_POSITION_CODE) Map[y][x] = c+1;
+		else Map[y][x] = -1;
+	}
+
+	printf("This is the cities' map:\n");
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	for (int y=0; y<Ny+1; y++){
+		for (int x=0; x<Nx+1; x++)
+			printf("%8d ", Map[y][x]);
+		printf("\n");
+	}
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean Distance between two cities
+// ****************************************************************************************************************
+double Distance(int A, int B) {
+	double result = sqrt(   (CitiesX[A]-CitiesX[B])*(CitiesX[A]-CitiesX[B]) + (CitiesY[A]-CitiesY[B])*(CitiesY[A]-CitiesY[B]) );
+	return result;
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean Distance in current path
+// ****************************************************************************************************************
+double PathDistance() {
+	double totDist = 0.0;
+	for (int i=0; i<N; i++) {
+		totDist += Distance(Path[i], Path[i+1]);
+	}
+	totDist += Distance(Path[N], Path[0]);
+	return totDist;
+}
+
+
+// ****************************************************************************************************************
+// Swaps cities if swapping results in shorter Distance. Thread <t> works only on the positions <first>..<last> of the
+// path: it swaps the cities of positions A, B with first < A < B < last, so A-1 and B+1 are inside its segment too
+// ****************************************************************************************************************
+double SwapCitiesInSegment(int first, int last, unsigned *seedPtr) {
+	unsigned seed = *seedPtr; // Local copy: the seeds of the threads share cache lines
+	double totDistChange = 0.0;
+	int range = last - first - 1; // Positions first+1 .. last-1
+	if (range < 2) return 0;
+	for (int r=0; r<STEPS_PER_THREAD_PER_REPETITION; r++) {
+		int A = first + 1 + rand_r(&seed) % range;
+		int B = first + 1 + rand_r(&seed) % range;
+		while (A==B) B = first + 1 + rand_r(&seed) % range;
+
+		if (A>B) { int temp = A; A = B; B = temp; } //always: A<B 
+		int flag = B-A-1; //always:flag=0 when A+1==B
+
+		double dist1_old = Distance(Path[A-1], Path[A]); //is always needed
+		double dist2_old = (!flag) ? 0 : Distance(Path[A], Path[A+1]); //dist ommited when A,B consecutive
+		double dist3_old = (!flag) ? 0 : Distance(Path[B-1], Path[B]); //dist ommited when A,B consecutive
+		double dist4_old = Distance(Path[B], Path[B+1]); //is always needed
+		double dist1_new = Distance(Path[A-1], Path[B]); //is always needed
+		double dist2_new = (!flag) ? 0 : Distance(Path[B], Path[A+1]); //dist ommited when A,B consecutive
+		double dist3_new = (!flag) ? 0 : Distance(Path[B-1], Path[A]); //dist ommited when A,B consecutive
+		double dist4_new = Distance(Path[A], Path[B+1]); //is always needed
+
+		double distChange = - dist1_old - dist2_old - dist3_old - dist4_old + dist1_new + dist2_new + dist3_new + dist4_new; 
+		if (distChange < 0) { //Must be <0 if it decreases the total Distance
+			int temp = Path[A];
+			Path[A] = Path[B];
+			Path[B] = temp;
+			totDistChange += distChange;
+		}
+	}
+	*seedPtr = seed;
+	return totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// Splits the path in one segment per thread, shifted by <shift> positions, and lets every thread swap cities in its own
+// segment. Segment t covers the positions Bounds[t]..Bounds[t+1] (Bounds[0]=0 and Bounds[THREADS]=N are never changed)
+// ****************************************************************************************************************
+double SwapCities(double totDist, int shift) {
+	double totDistChange = 0.0;
+	int Bounds[THREADS+1];
+	Bounds[0] = 0; Bounds[THREADS] = N;
+	for (int t=1; t<THREADS; t++) Bounds[t] = (int)((long long)t * N / THREADS) + shift;
+
+	#pragma omp parallel for reduction(+:totDistChange) schedule(static, 1) num_threads(THREADS)
+	for (int t=0; t<THREADS; t++) {
+		totDistChange += SwapCitiesInSegment(Bounds[t], Bounds[t+1], &Seeds[t]);
+	}
+	return totDist + totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// Checks if current program parameters lead to feasible spacial states
+// ****************************************************************************************************************
+int ValidateParameters() {
+	if (Nx*Ny<N) return 0;
+	if (N < 8*THREADS) return 0; //Every segment needs room for swaps
+	return 1;
+}
+
+
+// ****************************************************************************************************************
+// Seeds the random generator of every thread
+// ****************************************************************************************************************
+void InitializeSeeds() {
+	for (int t=0; t<THREADS; t++)
+		Seeds[t] = 1046900 + 83*t;
+}
+
+
+// ****************************************************************************************************************
+// The main program
+// ****************************************************************************************************************
+int main( int argc, const char* argv[] ) {
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	printf("This program searches for the optimal traveling Distance between %d cities,\n", N);
+	printf("spanning in an area of X=(0,%d) and Y=(0,%d)\n", Nx, Ny);
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    
+	if (ValidateParameters() == 0) {
+		printf("\nERROR: NOT ENOUGH SPACE ALLOCATED FOR GIVEN NUMBER OF CITIES (OR TOO FEW CITIES PER THREAD)\nThe program will now exit.\n"); return 1; }
+
+	int repetitions = 0, MaxRepetitions = DEFAULT_MAX_REPETITIONS; omp_set_dynamic(0);
+	if (argc>1) MaxRepetitions = atoi(argv[1]);
+
+	printf("Maximum number of repetitions set at: %d\n", MaxRepetitions);
+	printf("Maximum number of steps per thread per repetition set at: %llu\n", (unsigned long long)MaxRepetitions*STEPS_PER_THREAD_PER_REPETITION);
+
+	srand(1046900);
+    SetCities();
+	ResetPath();
+	RandomizePath();
+	InitializeSeeds();
+
+	double totDist = PathDistance();
+	printf("Now running the main algorithm...\n");
+	double swapsPerSecond = 0;
+	do {
+		if (repetitions%1==0) printf(">>REPETITION:%5d  >>BATCH:%11llu  >>ESTIMATED PATH_LENGTH: %.2lf  >>SWAPS/SEC: %.3e", repetitions, (unsigned long long)repetitions*STEPS_PER_THREAD_PER_REPETITION*THREADS, totDist, swapsPerSecond);
+		if (DEBUG) printf("  >>ACTUAL PATH_LENGTH: %.2lf", PathDistance());	
+		printf("\n");
+		repetitions ++;
+		int shift = rand() % (N / THREADS); //The segments' boundaries move on every repetition
+		double start = omp_get_wtime();
+        totDist = SwapCities(totDist, shift);
+		swapsPerSecond = STEPS_PER_THREAD_PER_REPETITION * (double)THREADS / (omp_get_wtime() - start);
+	} while ((repetitions<MaxRepetitions+1) && (totDist>THRESHOLD_DISTANCE));
+
+	printf("\nCalculations completed. Results:\n");
+	printf("Main-routine Repetitions: %d\n", repetitions);
+	printf(" Sub-routine Repetitions: %llu\n", (unsigned long long)repetitions*STEPS_PER_THREAD_PER_REPETITION*THREADS);
+	//printf("Estimation of the optimal path length: %.2lf\n", totDist);
+	printf("Actual optimal path length: %.2lf\n", PathDistance());
+    return 0 ;
+}
+
+
+
+
+
+
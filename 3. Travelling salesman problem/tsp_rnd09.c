@@ -0,0 +1,379 @@
+/*
+Description:
+    This program executes my "Random Swapping" algorithm to solve the "Travelling Salesman Problem"
+	Abides by Lab 3 Exercise 2 requirements
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+ 
+System Specifications:
+    CPU: AMD Ryzen 2600  (6 cores/12 threads,  @3.8 GHz,  6786.23 bogomips)
+    GPU: Nvidia GTX 1050 (dual-fan, overclocked)
+    RAM: 8GB (dual-channel, @2666 MHz)
+       
+Version Notes:
+    Compiles/Runs/Debugs with: gcc tsp_rnd09.c -o tsp_rnd09 -lm -fopt-info -fopenmp -O3 -pg && time ./tsp_rnd09 [seconds] && gprof ./tsp_rnd09
+	Executes the algorithm for 10.000 cities, spanning in an area of 1.000x1.000 km and produces correct results
+	Inherits all settings of the previous version unless stated otherwise
+    Added new / Modified existing functionalities:
+    --> Parallel tempering: every thread improves its own copy of the path (replica) at its own temperature. The <THREADS>
+        temperatures are spread geometrically from <T_MIN> to <T_MAX>
+    --> Moves: the swap of two cities (same distance bookkeeping as before) or, with <TWO_OPT_POSSIBILITY>, the reversal
+        of the part of the path between two positions at most <MAX_REVERSAL> apart (2-opt). A move that makes the path
+        longer by distChange is also accepted with possibility exp(-distChange/T) (Metropolis)
+    --> Every <STEPS_PER_EXCHANGE> steps, the replicas of neighboring temperatures exchange their temperatures with
+        possibility min(1, exp((1/T1-1/T2)*(D1-D2))) (even pairs, then odd pairs on the next exchange)
+    --> Runs for a fixed wall-clock budget of <TIME_BUDGET> seconds (or the first argument) and keeps the shortest path
+        met by any replica in <BestPath>
+    --> Every replica draws from a local copy of its seed during AnnealReplica(), written back to <Seeds> at the end
+*/	
+
+
+// ****************************************************************************************************************    
+#pragma GCC optimize("O3","unroll-loops","omit-frame-pointer","inline") //Apply O3 and extra optimizations
+#pragma GCC option("arch=native","tune=native","no-zero-upper") //Adapt to the current system
+#pragma GCC target("avx")  //Enable AVX
+
+
+// **************************************************************************************************************** 
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "omp.h"
+
+
+// ****************************************************************************************************************
+#define N  10000
+#define Nx 1000
+#define Ny 1000
+#define VACANT_POSITION_CODE -999999
+
+#define THREADS 12
+#define TIME_BUDGET 60            // Seconds
+#define STEPS_PER_EXCHANGE 100000 // Steps of every replica between two exchanges
+#define T_MIN 0.5                 // The coldest temperature
+#define T_MAX 50.0                // The hottest temperature
+#define TWO_OPT_POSSIBILITY 0.5   // Possibility of a 2-opt move instead of a swap
+#define MAX_REVERSAL 1000         // Maximum length of the reversed part of a 2-opt move
+#define REPORT_INTERVAL 5         // Seconds between two reports
+
+#define DEBUG 1
+
+
+// ****************************************************************************************************************
+float CitiesX[N];
+float CitiesY[N];
+int Path[N+1];
+int ReplicaPath[THREADS][N+1];    // The path of every replica (thread)
+double ReplicaDist[THREADS];      // The length of the path of every replica
+int TemperatureOfReplica[THREADS]; // Index of the temperature of every replica (0 is the coldest)
+double Temperatures[THREADS];
+int BestPath[N+1];
+unsigned Seeds[THREADS]; // The random seed of each thread
+
+
+// ****************************************************************************************************************
+// Initializes the cities' positions
+// ****************************************************************************************************************
+void SetCities() {
+	printf("Now initializing the positions of the cities...\n");
+	for (int i=0; i<N; i++) {
+		CitiesX[i] = Nx * (float) rand() / RAND_MAX;
+		CitiesY[i] = Ny * (float) rand() / RAND_MAX;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Initializes the traveling path
+// ****************************************************************************************************************
+void ResetPath() {
+	printf("Now initializing the path...\n");
+	for (int i=0; i<N+1; i++)
+		Path[i] = -1;
+}
+
+
+// ****************************************************************************************************************
+// Checks if a city is already in the path
+// ****************************************************************************************************************
+int IsInPath(int k) {
+	for (int i=0; i<N; i++)
+		if (Path[i] == k) return 1;
+	return 0;
+}
+
+
+// ****************************************************************************************************************
+// Creates a random path
+// ****************************************************************************************************************
+void RandomizePath() {
+	int k;
+	printf("Now randomizing the path...\n");
+
+	Path[0] = rand() % N;
+	Path[N] = Path[0];
+
+	for (int i=1; i<N; i++) {
+		
+		do {
+			k = ((float)N*rand())/RAND_MAX;
+		} while (IsInPath(k) == 1);
+		Path[i] = k;
+	}
+}
+
+
+// ****************************************************************************************************************
+// Prints the cities' positions
+// ****************************************************************************************************************
+void PrintCities() {
+	printf("> The cities are:\n");
+	for (int i=0; i<N; i++) {
+		printf(">> City: %6d  X:%5.2f Y:%5.2f\n", i, CitiesX[i], CitiesY[i] );
+	}
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Visually maps the cities' positions
+// ****************************************************************************************************************
+void MapCities() {
+	int Map[Ny+1][Nx+1];
+	printf("Now creating a visual map of the cities...\n");
+	for (int i=0; i<Nx+1; i++) 
+		for (int j=0; j<Ny+1; j++) 
+			Map[j][i] = (float) VACANT_POSITION_CODE;
+
+
+	//printf("Quantized coordinates are:\n");
+	for (int c=0; c<N; c++) {
+		int x = (int) CitiesX[c] ;
+		int y = (int) CitiesY[c] ;
+		//printf(" City:%d  y=%d and x=%d\n",c,y,x);
+		if (Map[y][x] == VACANT_POSITION_CODE) Map[y][x] = c+1;
+		else Map[y][x] = -1;
+	}
+
+	printf("This is the cities' map:\n");
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	for (int y=0; y<Ny+1; y++){
+		for (int x=0; x<Nx+1; x++)
+			printf("%8d ", Map[y][x]);
+		printf("\n");
+	}
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	printf("\n");
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean Distance between two cities
+// ****************************************************************************************************************
+double Distance(int A, int B) {
+	double result = sqrt(   (CitiesX[A]-CitiesX[B])*(CitiesX[A]-CitiesX[B]) + (CitiesY[A]-CitiesY[B])*(CitiesY[A]-CitiesY[B]) );
+	return result;
+}
+
+
+// ****************************************************************************************************************
+// Finds Euclidean Distance in a given path
+// ****************************************************************************************************************
+double PathDistance_2(int Path[]) {
+	double totDist = 0.0;
+	for (int i=0; i<N; i++) {
+		totDist += Distance(Path[i], Path[i+1]);
+	}
+	return totDist;
+}
+
+
+// ****************************************************************************************************************
+// Metropolis criterion: a move that changes the path distance by <distChange> is accepted at temperature <T>
+// ****************************************************************************************************************
+static inline int AcceptMove(double distChange, double T, unsigned *seed) {
+	if (distChange < 0) return 1;
+	return ((double) rand_r(seed) / RAND_MAX) < exp(-distChange / T);
+}
+
+
+// ****************************************************************************************************************
+// Tries to swap the cities of positions A and B (A<B) of <Path>. Returns the change of the path distance
+// ****************************************************************************************************************
+double TrySwapMove(int Path[], int A, int B, double T, unsigned *seed) {
+	int flag = B-A-1; //always:flag=0 when A+1==B
+
+	double dist1_old = Distance(Path[A-1], Path[A]); //is always needed
+	double dist2_old = (!flag) ? 0 : Distance(Path[A], Path[A+1]); //dist ommited when A,B consecutive
+	double dist3_old = (!flag) ? 0 : Distance(Path[B-1], Path[B]); //dist ommited when A,B consecutive
+	double dist4_old = Distance(Path[B], Path[B+1]); //is always needed
+	double dist1_new = Distance(Path[A-1], Path[B]); //is always needed
+	double dist2_new = (!flag) ? 0 : Distance(Path[B], Path[A+1]); //dist ommited when A,B consecutive
+	double dist3_new = (!flag) ? 0 : Distance(Path[B-1], Path[A]); //dist ommited when A,B consecutive
+	double dist4_new = Distance(Path[A], Path[B+1]); //is always needed
+
+	double distChange = - dist1_old - dist2_old - dist3_old - dist4_old + dist1_new + dist2_new + dist3_new + dist4_new; 
+	if (!AcceptMove(distChange, T, seed)) return 0;
+	int temp = Path[A];
+	Path[A] = Path[B];
+	Path[B] = temp;
+	return distChange;
+}
+
+
+// ****************************************************************************************************************
+// Tries to reverse the positions A..B (A<B) of <Path>: the edges A-1,A and B,B+1 become A-1,B and A,B+1.
+// Returns the change of the path distance
+// ****************************************************************************************************************
+double TryTwoOptMove(int Path[], int A, int B, double T, unsigned *seed) {
+	double dist1_old = Distance(Path[A-1], Path[A]);
+	double dist2_old = Distance(Path[B], Path[B+1]);
+	double dist1_new = Distance(Path[A-1], Path[B]);
+	double dist2_new = Distance(Path[A], Path[B+1]);
+
+	double distChange = - dist1_old - dist2_old + dist1_new + dist2_new;
+	if (!AcceptMove(distChange, T, seed)) return 0;
+	for (; A<B; A++, B--) {
+		int temp = Path[A];
+		Path[A] = Path[B];
+		Path[B] = temp;
+	}
+	return distChange;
+}
+
+
+// ****************************************************************************************************************
+// Runs <STEPS_PER_EXCHANGE> moves on the replica of thread <t> at its current temperature
+// ****************************************************************************************************************
+void AnnealReplica(int t) {
+	int *Path = ReplicaPath[t];
+	unsigned seed = Seeds[t]; // Local copy: the seeds of the threads share cache lines
+	double T = Temperatures[TemperatureOfReplica[t]], totDistChange = 0.0;
+	for (int r=0; r<STEPS_PER_EXCHANGE; r++) {
+		if ((double) rand_r(&seed) / RAND_MAX < TWO_OPT_POSSIBILITY) {
+			int A = 1 + rand_r(&seed) % (N-2);
+			int B = A + 1 + rand_r(&seed) % MAX_REVERSAL;
+			if (B > N-1) B = N-1;
+			totDistChange += TryTwoOptMove(Path, A, B, T, &seed);
+		} else {
+			int A = 1 + rand_r(&seed) % (N-1);
+			int B = 1 + rand_r(&seed) % (N-1);
+			while (A==B) B = 1 + rand_r(&seed) % (N-1);
+			if (A>B) { int temp = A; A = B; B = temp; } //always: A<B 
+			totDistChange += TrySwapMove(Path, A, B, T, &seed);
+		}
+	}
+	Seeds[t] = seed;
+	ReplicaDist[t] += totDistChange;
+}
+
+
+// ****************************************************************************************************************
+// Exchanges the temperatures of the replicas of neighboring temperatures (pairs 0-1, 2-3, ... when <phase> is 0 and
+// 1-2, 3-4, ... when it is 1). Returns the number of exchanges
+// ****************************************************************************************************************
+int ExchangeReplicas(int phase) {
+	int ReplicaAtTemperature[THREADS], exchanges = 0;
+	for (int t=0; t<THREADS; t++) ReplicaAtTemperature[TemperatureOfReplica[t]] = t;
+	for (int k=phase; k+1<THREADS; k+=2) {
+		int cold = ReplicaAtTemperature[k], hot = ReplicaAtTemperature[k+1];
+		double exponent = (1/Temperatures[k] - 1/Temperatures[k+1]) * (ReplicaDist[cold] - ReplicaDist[hot]);
+		if (exponent >= 0 || ((double) rand() / RAND_MAX) < exp(exponent)) {
+			TemperatureOfReplica[cold] = k+1; TemperatureOfReplica[hot] = k;
+			exchanges ++;
+		}
+	}
+	return exchanges;
+}
+
+
+// ****************************************************************************************************************
+// Gives every replica the initial path, a temperature and a random seed
+// ****************************************************************************************************************
+void InitializeReplicas() {
+	for (int t=0; t<THREADS; t++) {
+		for (int i=0; i<N+1; i++) ReplicaPath[t][i] = Path[i];
+		ReplicaDist[t] = PathDistance_2(Path);
+		Temperatures[t] = (THREADS > 1) ? T_MIN * pow(T_MAX / T_MIN, t / (double)(THREADS-1)) : T_MIN;
+		TemperatureOfReplica[t] = t;
+		Seeds[t] = 1046900 + 83*t;
+	}
+	for (int i=0; i<N+1; i++) BestPath[i] = Path[i];
+}
+
+
+// ****************************************************************************************************************
+// Checks if current program parameters lead to feasible spacial states
+// ****************************************************************************************************************
+int ValidateParameters() {
+	if (Nx*Ny<N) return 0;
+	if (N < 4) return 0;
+	return 1;
+}
+
+
+// ****************************************************************************************************************
+// The main program
+// ****************************************************************************************************************
+int main( int argc, const char* argv[] ) {
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+	printf("This program searches for the optimal traveling Distance between %d cities,\n", N);
+	printf("spanning in an area of X=(0,%d) and Y=(0,%d)\n", Nx, Ny);
+	printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+    
+	if (ValidateParameters() == 0) {
+		printf("\nERROR: NOT ENOUGH SPACE ALLOCATED FOR GIVEN NUMBER OF CITIES\nThe program will now exit.\n"); return 1; }
+
+	double timeBudget = TIME_BUDGET; omp_set_dynamic(0);
+	if (argc>1) timeBudget = atof(argv[1]);
+	printf("Time budget set at: %.1lf seconds\n", timeBudget);
+
+	srand(1046900);
+    SetCities();
+	ResetPath();
+	RandomizePath();
+	InitializeReplicas();
+
+	double bestDist = ReplicaDist[0];
+	long long rounds = 0, exchanges = 0;
+	int done = 0;
+	double start = omp_get_wtime(), lastReport = start;
+	printf("Now running the main algorithm with %d replicas (T = %.2lf ... %.2lf)...\n", THREADS, T_MIN, T_MAX);
+	#pragma omp parallel num_threads(THREADS)
+	{
+		int t = omp_get_thread_num();
+		while (!done) {
+			AnnealReplica(t);
+			#pragma omp barrier
+			#pragma omp single
+			{
+				for (int r=0; r<THREADS; r++)
+					if (ReplicaDist[r] < bestDist) {
+						ReplicaDist[r] = PathDistance_2(ReplicaPath[r]); //Also removes the rounding errors of the sums
+						if (ReplicaDist[r] < bestDist) { bestDist = ReplicaDist[r]; for (int i=0; i<N+1; i++) BestPath[i] = ReplicaPath[r][i]; }
+					}
+				exchanges += ExchangeReplicas(rounds % 2);
+				rounds ++;
+				double now = omp_get_wtime();
+				if (now - lastReport >= REPORT_INTERVAL) {
+					int coldest = 0; for (int r=0; r<THREADS; r++) if (TemperatureOfReplica[r] == 0) coldest = r;
+					printf(">>TIME: %7.1lf  >>ROUNDS: %8lld  >>BEST PATH_LENGTH: %.2lf  >>COLDEST REPLICA: %.2lf  >>EXCHANGES: %.1lf%%\n",
+						now - start, rounds, bestDist, ReplicaDist[coldest], 100.0 * exchanges / (rounds * (THREADS-1) / 2.0 + 1e-9));
+					lastReport = now;
+				}
+				if (now - start >= timeBudget) done = 1;
+			}
+		}
+	}
+
+	printf("\nCalculations completed. Results:\n");
+	printf("Exchange rounds: %lld\n", rounds);
+	printf("Steps: %lld\n", rounds*STEPS_PER_EXCHANGE*THREADS);
+	printf("Estimation of the optimal path length: %.2lf\n", bestDist);
+	printf("Actual optimal path length: %.2lf\n", PathDistance_2(BestPath));
+    return 0 ;
+}
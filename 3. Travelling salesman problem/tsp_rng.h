@@ -0,0 +1,138 @@
+/*
+Description:
+    Random number generator shared by the "Travelling Salesman Problem" programs (#include "tsp_rng.h")
+    Every thread draws from its own stream, so there is no shared state (rand()) and no seeding per draw (rand_r() seeded
+    with omp_get_wtime())
+
+Author:
+    Georgios Evangelou (1046900)
+    Year: 5
+    Parallel Programming in Machine Learning Problems
+    Electrical and Computer Engineering Department, University of Patras
+
+Version Notes:
+    --> The generator is xoshiro256** (256 bits of state, period 2^256-1), seeded through splitmix64
+    --> RngStreams() gives every thread a stream 2^128 draws apart from the previous one (jump-ahead), so the streams
+        never overlap and depend only on the seed and the number of streams
+    --> RngBounded() returns an integer in [0,bound) without the bias of rand()%bound (multiply-shift with rejection),
+        RngFloat()/RngDouble() return a number in [0,1)
+    --> Every stream takes a whole cache line, so the streams of the threads never share one
+    --> Used by the newest version of every solver family and by all later versions: tsp_rnd10, tsp_hh09, tsp_ant07-14,
+        tsp_opt05 and tsp_cluster01. The earlier versions are kept as they were, so every version still shows what it
+        changed: tsp_rnd01-09 (rand_r()/rand()), tsp_hh01-08, tsp_ant01-06 and tsp_opt03-04 (rand_r()), tsp_opt01-02
+        (rand() for the random path). tsp_rnd10, tsp_hh09, tsp_ant07 and tsp_opt05 are tsp_rnd09, tsp_hh08, tsp_ant06
+        and tsp_opt04 moved onto these streams
+    --> All programs still place the cities with srand(1046900)/rand(), so every version solves the same problem
+*/
+#ifndef TSP_RNG_H
+#define TSP_RNG_H
+
+
+// ****************************************************************************************************************
+typedef struct {
+	unsigned long long s[4];
+} __attribute__((aligned(64))) Rng;
+
+
+// ****************************************************************************************************************
+// Rotates <x> left by <k> bits
+// ****************************************************************************************************************
+static inline unsigned long long RngRotl(unsigned long long x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+
+// ****************************************************************************************************************
+// Returns the next 64 random bits of the stream <rng> (xoshiro256**)
+// ****************************************************************************************************************
+static inline unsigned long long RngNext(Rng *rng) {
+	unsigned long long *s = rng->s;
+	unsigned long long result = RngRotl(s[1] * 5, 7) * 9;
+	unsigned long long t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = RngRotl(s[3], 45);
+	return result;
+}
+
+
+// ****************************************************************************************************************
+// Returns a random integer in [0,bound) (bound > 0) without modulo bias
+// ****************************************************************************************************************
+static inline unsigned RngBounded(Rng *rng, unsigned bound) {
+	unsigned long long m = (RngNext(rng) >> 32) * (unsigned long long) bound;
+	unsigned low = (unsigned) m;
+	if (low < bound) { //Only then the result may be biased
+		unsigned threshold = -bound % bound;
+		while (low < threshold) {
+			m = (RngNext(rng) >> 32) * (unsigned long long) bound;
+			low = (unsigned) m;
+		}
+	}
+	return (unsigned) (m >> 32);
+}
+
+
+// ****************************************************************************************************************
+// Returns a random float in [0,1)
+// ****************************************************************************************************************
+static inline float RngFloat(Rng *rng) {
+	return (RngNext(rng) >> 40) * 0x1.0p-24f;
+}
+
+
+// ****************************************************************************************************************
+// Returns a random double in [0,1)
+// ****************************************************************************************************************
+static inline double RngDouble(Rng *rng) {
+	return (RngNext(rng) >> 11) * 0x1.0p-53;
+}
+
+
+// ****************************************************************************************************************
+// Fills the state of <rng> from <seed> (splitmix64), so that similar seeds give unrelated streams
+// ****************************************************************************************************************
+static inline void RngSeed(Rng *rng, unsigned long long seed) {
+	for (int i=0; i<4; i++) {
+		unsigned long long z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		rng->s[i] = z ^ (z >> 31);
+	}
+}
+
+
+// ****************************************************************************************************************
+// Advances <rng> by 2^128 draws
+// ****************************************************************************************************************
+static inline void RngJump(Rng *rng) {
+	static const unsigned long long JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+	unsigned long long s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	for (int i=0; i<4; i++)
+		for (int b=0; b<64; b++) {
+			if (JUMP[i] & (1ULL << b)) {
+				s0 ^= rng->s[0]; s1 ^= rng->s[1]; s2 ^= rng->s[2]; s3 ^= rng->s[3];
+			}
+			RngNext(rng);
+		}
+	rng->s[0] = s0; rng->s[1] = s1; rng->s[2] = s2; rng->s[3] = s3;
+}
+
+
+// ****************************************************************************************************************
+// Gives <count> non-overlapping streams: the first one is seeded by <seed> and each next one is 2^128 draws ahead
+// ****************************************************************************************************************
+static inline void RngStreams(Rng Streams[], int count, unsigned long long seed) {
+	if (count < 1) return;
+	RngSeed(&Streams[0], seed);
+	for (int i=1; i<count; i++) {
+		Streams[i] = Streams[i-1];
+		RngJump(&Streams[i]);
+	}
+}
+
+
+#endif